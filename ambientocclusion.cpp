@@ -0,0 +1,470 @@
+// ========================================================================= //
+// Content: BVH ray caster and per-vertex ambient occlusion bake             //
+// ========================================================================= //
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+#if defined(__SSE__) || defined(_M_X64)
+#    include <xmmintrin.h>
+#    define AO_USE_SSE
+#endif
+
+#include <QElapsedTimer>
+#include <QtMath>
+
+#include "ambientocclusion.h"
+#include "parallel.h"
+
+namespace {
+
+const unsigned int BIN_COUNT = 16;
+const uint32_t LEAF_TRIANGLES = 4;
+// deeper subtrees become leaves, keeps the traversal stack small
+const unsigned int MAX_DEPTH = 48;
+
+struct Bounds
+{
+    Vec3f lo = Vec3f(FLT_MAX);
+    Vec3f hi = Vec3f(-FLT_MAX);
+
+    void grow(const Vec3f &p)
+    {
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            lo[axis] = std::min(lo[axis], p[axis]);
+            hi[axis] = std::max(hi[axis], p[axis]);
+        }
+    }
+    void grow(const Bounds &b)
+    {
+        grow(b.lo);
+        grow(b.hi);
+    }
+    float area() const
+    {
+        const Vec3f d = hi - lo;
+        return d.x() < 0.f ? 0.f : 2.f * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+    }
+};
+
+// 32 bit mixing function (lowbias32) for the per-vertex sample rotation
+uint32_t mixBits(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float toUnitFloat(uint32_t x)
+{
+    return (x >> 8) * (1.f / 16777216.f);
+}
+
+} // namespace
+
+// ===========
+// === BVH ===
+// ===========
+
+struct TriangleBVH::BuildState
+{
+    vector<Bounds> triangleBounds;
+    vector<Vec3f> centroids;
+    vector<uint32_t> order;
+};
+
+void TriangleBVH::build(const vector<Vec3f> &vertices, const vector<Vec3i> &triangles)
+{
+    nodes.clear();
+    corners.clear();
+    edges1.clear();
+    edges2.clear();
+    const size_t count = triangles.size();
+    if (count == 0 || count > UINT32_MAX / 2)
+        return;
+
+    BuildState state;
+    state.triangleBounds.resize(count);
+    state.centroids.resize(count);
+    parallelFor(0, count, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            Bounds b;
+            for (unsigned int k = 0; k < 3; ++k)
+                b.grow(vertices[triangles[t][k]]);
+            state.triangleBounds[t] = b;
+            state.centroids[t] = (b.lo + b.hi) * 0.5f;
+        }
+    });
+    state.order.resize(count);
+    std::iota(state.order.begin(), state.order.end(), 0u);
+    nodes.reserve(2 * count / LEAF_TRIANGLES + 1);
+    buildNode(state, 0, static_cast<uint32_t>(count), 0);
+
+    corners.resize(count);
+    edges1.resize(count);
+    edges2.resize(count);
+    parallelFor(0, count, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const Vec3i &tri = triangles[state.order[i]];
+            corners[i] = vertices[tri[0]];
+            edges1[i] = vertices[tri[1]] - vertices[tri[0]];
+            edges2[i] = vertices[tri[2]] - vertices[tri[0]];
+        }
+    });
+}
+
+// top down and depth first, so the left child always directly follows its parent
+void TriangleBVH::buildNode(BuildState &state, uint32_t first, uint32_t count, unsigned int depth)
+{
+    const uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    Bounds bounds, centroidBounds;
+    for (uint32_t i = first; i < first + count; ++i) {
+        bounds.grow(state.triangleBounds[state.order[i]]);
+        centroidBounds.grow(state.centroids[state.order[i]]);
+    }
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        nodes[index].bboxMin[axis] = bounds.lo[axis];
+        nodes[index].bboxMax[axis] = bounds.hi[axis];
+    }
+    if (count <= LEAF_TRIANGLES || depth >= MAX_DEPTH) {
+        nodes[index].first = first;
+        nodes[index].count = count;
+        return;
+    }
+
+    // binned surface area heuristic along the largest centroid extent
+    const Vec3f extent = centroidBounds.hi - centroidBounds.lo;
+    const unsigned int axis = extent.x() > extent.y() ? (extent.x() > extent.z() ? 0 : 2)
+                                                      : (extent.y() > extent.z() ? 1 : 2);
+    uint32_t *begin = state.order.data() + first;
+    uint32_t *end = begin + count;
+    uint32_t *middle = begin;
+    if (extent[axis] > 0.f) {
+        const float scale = BIN_COUNT / extent[axis];
+        const float lo = centroidBounds.lo[axis];
+        const auto binOf = [&](uint32_t t) {
+            const float bin = (state.centroids[t][axis] - lo) * scale;
+            return std::min(static_cast<unsigned int>(bin), BIN_COUNT - 1);
+        };
+        Bounds binBounds[BIN_COUNT];
+        uint32_t binCounts[BIN_COUNT] = {};
+        for (const uint32_t *t = begin; t != end; ++t) {
+            const unsigned int bin = binOf(*t);
+            binBounds[bin].grow(state.triangleBounds[*t]);
+            ++binCounts[bin];
+        }
+        // cost of splitting behind bin i, the right sides are accumulated from the back
+        float rightCost[BIN_COUNT];
+        Bounds accumulated;
+        uint32_t accumulatedCount = 0;
+        for (unsigned int i = BIN_COUNT - 1; i > 0; --i) {
+            accumulated.grow(binBounds[i]);
+            accumulatedCount += binCounts[i];
+            rightCost[i - 1] = accumulated.area() * accumulatedCount;
+        }
+        accumulated = Bounds();
+        accumulatedCount = 0;
+        float bestCost = FLT_MAX;
+        unsigned int bestSplit = 0;
+        for (unsigned int i = 0; i + 1 < BIN_COUNT; ++i) {
+            accumulated.grow(binBounds[i]);
+            accumulatedCount += binCounts[i];
+            const float cost = accumulated.area() * accumulatedCount + rightCost[i];
+            if (accumulatedCount > 0 && accumulatedCount < count && cost < bestCost) {
+                bestCost = cost;
+                bestSplit = i;
+            }
+        }
+        if (bestCost < FLT_MAX)
+            middle = std::partition(begin, end, [&](uint32_t t) { return binOf(t) <= bestSplit; });
+    }
+    if (middle == begin || middle == end) {
+        // all centroids fall into one bin: split at the median
+        middle = begin + count / 2;
+        std::nth_element(begin, middle, end, [&](uint32_t l, uint32_t r) {
+            return state.centroids[l][axis] < state.centroids[r][axis];
+        });
+    }
+    const uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+    buildNode(state, first, leftCount, depth + 1);
+    nodes[index].first = static_cast<uint32_t>(nodes.size());
+    nodes[index].count = 0;
+    buildNode(state, first + leftCount, count - leftCount, depth + 1);
+}
+
+unsigned int TriangleBVH::occluded4(const Vec3f &origin, const float dirX[4],
+                                    const float dirY[4], const float dirZ[4], float maxDistance,
+                                    unsigned int activeMask) const
+{
+    activeMask &= 0xf;
+    if (nodes.empty() || activeMask == 0)
+        return 0;
+
+    // reciprocal directions for the slab test. tiny components are clamped so that a ray
+    // parallel to a slab never computes 0 * inf.
+    float inverse[3][4];
+    const float *directions[3] = { dirX, dirY, dirZ };
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        for (unsigned int lane = 0; lane < 4; ++lane) {
+            const float d = directions[axis][lane];
+            inverse[axis][lane] = 1.f / (std::fabs(d) < 1e-12f ? std::copysign(1e-12f, d) : d);
+        }
+    }
+
+    unsigned int hits = 0;
+    uint32_t stack[MAX_DEPTH + 2];
+    unsigned int stackSize = 0;
+    stack[stackSize++] = 0;
+
+#ifdef AO_USE_SSE
+    const __m128 dx = _mm_loadu_ps(dirX), dy = _mm_loadu_ps(dirY), dz = _mm_loadu_ps(dirZ);
+    const __m128 ix = _mm_loadu_ps(inverse[0]), iy = _mm_loadu_ps(inverse[1]),
+                 iz = _mm_loadu_ps(inverse[2]);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+    const __m128 maxT = _mm_set1_ps(maxDistance);
+    const __m128 minDet = _mm_set1_ps(1e-12f);
+
+    while (stackSize > 0) {
+        const uint32_t nodeIndex = stack[--stackSize];
+        const Node &node = nodes[nodeIndex];
+
+        // slab test of all four rays against the node box
+        __m128 t0 = _mm_mul_ps(_mm_set1_ps(node.bboxMin[0] - origin.x()), ix);
+        __m128 t1 = _mm_mul_ps(_mm_set1_ps(node.bboxMax[0] - origin.x()), ix);
+        __m128 tNear = _mm_max_ps(zero, _mm_min_ps(t0, t1));
+        __m128 tFar = _mm_min_ps(maxT, _mm_max_ps(t0, t1));
+        t0 = _mm_mul_ps(_mm_set1_ps(node.bboxMin[1] - origin.y()), iy);
+        t1 = _mm_mul_ps(_mm_set1_ps(node.bboxMax[1] - origin.y()), iy);
+        tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+        tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+        t0 = _mm_mul_ps(_mm_set1_ps(node.bboxMin[2] - origin.z()), iz);
+        t1 = _mm_mul_ps(_mm_set1_ps(node.bboxMax[2] - origin.z()), iz);
+        tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+        tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+        if ((_mm_movemask_ps(_mm_cmple_ps(tNear, tFar)) & activeMask) == 0)
+            continue;
+
+        if (node.count == 0) {
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = nodeIndex + 1;
+            continue;
+        }
+
+        // Moeller-Trumbore, the terms that only depend on the common origin are scalar
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const Vec3f &e1 = edges1[i], &e2 = edges2[i];
+            const Vec3f s = origin - corners[i];
+            const Vec3f q = cross(s, e1);
+            const __m128 e2x = _mm_set1_ps(e2.x()), e2y = _mm_set1_ps(e2.y()),
+                         e2z = _mm_set1_ps(e2.z());
+            const __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+            const __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+            const __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+            const __m128 det = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e1.x()), px),
+                               _mm_mul_ps(_mm_set1_ps(e1.y()), py)),
+                    _mm_mul_ps(_mm_set1_ps(e1.z()), pz));
+            const __m128 invDet = _mm_div_ps(one, det);
+            const __m128 u = _mm_mul_ps(
+                    _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(s.x()), px),
+                                          _mm_mul_ps(_mm_set1_ps(s.y()), py)),
+                               _mm_mul_ps(_mm_set1_ps(s.z()), pz)),
+                    invDet);
+            const __m128 v = _mm_mul_ps(
+                    _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_set1_ps(q.x())),
+                                          _mm_mul_ps(dy, _mm_set1_ps(q.y()))),
+                               _mm_mul_ps(dz, _mm_set1_ps(q.z()))),
+                    invDet);
+            const __m128 t = _mm_mul_ps(_mm_set1_ps(e2 * q), invDet);
+            __m128 valid = _mm_cmpgt_ps(_mm_max_ps(det, _mm_sub_ps(zero, det)), minDet);
+            valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+            valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+            valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), one));
+            valid = _mm_and_ps(valid, _mm_cmpgt_ps(t, zero));
+            valid = _mm_and_ps(valid, _mm_cmplt_ps(t, maxT));
+            const unsigned int hit = _mm_movemask_ps(valid) & activeMask;
+            if (hit) {
+                hits |= hit;
+                activeMask &= ~hit;
+                if (activeMask == 0)
+                    return hits;
+            }
+        }
+    }
+#else
+    while (stackSize > 0) {
+        const uint32_t nodeIndex = stack[--stackSize];
+        const Node &node = nodes[nodeIndex];
+
+        unsigned int boxMask = 0;
+        for (unsigned int lane = 0; lane < 4; ++lane) {
+            float tNear = 0.f, tFar = maxDistance;
+            for (unsigned int axis = 0; axis < 3; ++axis) {
+                const float t0 = (node.bboxMin[axis] - origin[axis]) * inverse[axis][lane];
+                const float t1 = (node.bboxMax[axis] - origin[axis]) * inverse[axis][lane];
+                tNear = std::max(tNear, std::min(t0, t1));
+                tFar = std::min(tFar, std::max(t0, t1));
+            }
+            boxMask |= (tNear <= tFar) << lane;
+        }
+        if ((boxMask & activeMask) == 0)
+            continue;
+
+        if (node.count == 0) {
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = nodeIndex + 1;
+            continue;
+        }
+
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const Vec3f s = origin - corners[i];
+            const Vec3f q = cross(s, edges1[i]);
+            for (unsigned int lane = 0; lane < 4; ++lane) {
+                if (!(activeMask & (1u << lane)))
+                    continue;
+                const Vec3f d(dirX[lane], dirY[lane], dirZ[lane]);
+                const Vec3f p = cross(d, edges2[i]);
+                const float det = edges1[i] * p;
+                if (std::fabs(det) <= 1e-12f)
+                    continue;
+                const float invDet = 1.f / det;
+                const float u = (s * p) * invDet, v = (d * q) * invDet;
+                const float t = (edges2[i] * q) * invDet;
+                if (u >= 0.f && v >= 0.f && u + v <= 1.f && t > 0.f && t < maxDistance) {
+                    hits |= 1u << lane;
+                    activeMask &= ~(1u << lane);
+                }
+            }
+            if (activeMask == 0)
+                return hits;
+        }
+    }
+#endif
+    return hits;
+}
+
+// =======================
+// === OCCLUSION BAKE ===
+// =======================
+
+AmbientOcclusionBake::AmbientOcclusionBake(const vector<Vec3f> &vertices,
+                                           const vector<Vec3f> &normals,
+                                           const vector<Vec3i> &triangles, float maxDistance)
+    : vertices(vertices), normals(normals), triangles(triangles), maxDistance(maxDistance)
+{
+    Bounds bounds;
+    for (const auto &v : vertices)
+        bounds.grow(v);
+    const float diagonal = vertices.empty() ? 0.f : bounds.lo.distance(bounds.hi);
+    if (this->maxDistance <= 0.f)
+        this->maxDistance = 0.25f * diagonal;
+    // rays start slightly above the surface so that they do not hit their own triangles
+    originOffset = 1e-4f * diagonal;
+    visible.assign(vertices.size(), 0);
+}
+
+size_t AmbientOcclusionBake::refine(unsigned int raysPerVertex)
+{
+    const unsigned int packets = (raysPerVertex + 3) / 4;
+    const size_t count = vertices.size();
+    if (packets == 0 || count == 0 || (bvh.empty() && triangles.empty())
+        || normals.size() != count)
+        return 0;
+
+    QElapsedTimer timer;
+    timer.start();
+    if (bvh.empty()) {
+        bvh.build(vertices, triangles);
+        vector<Vec3i>().swap(triangles);
+        buildTime = timer.restart();
+    }
+    // the cost per vertex varies a lot, so the workers fetch small blocks of vertices
+    const size_t blockSize = 64;
+    std::atomic<size_t> nextBlock(0);
+    const unsigned int firstSample = samples;
+    // unoccluded rays of this pass, merged into visible unless the pass gets cancelled
+    vector<uint32_t> passVisible(count, 0);
+    parallelFor(
+            0, workerCount(),
+            [&](size_t, size_t) {
+                size_t first;
+                while (!cancelled && (first = nextBlock.fetch_add(blockSize)) < count) {
+                    const size_t last = std::min(count, first + blockSize);
+                    for (size_t v = first; v < last; ++v) {
+                        const Vec3f n = normals[v].normalized();
+                        if (n.sqlength() < 0.5f) {
+                            // no normal: count the vertex as unoccluded
+                            passVisible[v] = 4 * packets;
+                            continue;
+                        }
+                        // orthonormal basis around the normal (Duff et al.)
+                        const float sign = std::copysign(1.f, n.z());
+                        const float a = -1.f / (sign + n.z());
+                        const float b = n.x() * n.y() * a;
+                        const Vec3f tangent(1.f + sign * n.x() * n.x() * a, sign * b,
+                                            -sign * n.x());
+                        const Vec3f bitangent(b, sign + n.y() * n.y() * a, -n.y());
+                        const Vec3f origin = vertices[v] + n * originOffset;
+
+                        // progressive 2D low discrepancy sequence (R2), rotated per vertex
+                        const uint32_t seed = mixBits(static_cast<uint32_t>(v));
+                        const float r1 = toUnitFloat(seed), r2 = toUnitFloat(mixBits(seed));
+                        uint32_t unoccluded = 0;
+                        for (unsigned int packet = 0; packet < packets; ++packet) {
+                            float dirX[4], dirY[4], dirZ[4];
+                            for (unsigned int lane = 0; lane < 4; ++lane) {
+                                const unsigned int s = firstSample + 4 * packet + lane;
+                                const float u1 = std::fmod(r1 + s * 0.7548776662f, 1.f);
+                                const float u2 = std::fmod(r2 + s * 0.5698402910f, 1.f);
+                                // cosine distributed over the hemisphere
+                                const float radius = std::sqrt(u1);
+                                const float phi = 2.f * float(M_PI) * u2;
+                                const Vec3f d = tangent * (radius * std::cos(phi))
+                                        + bitangent * (radius * std::sin(phi))
+                                        + n * std::sqrt(std::max(0.f, 1.f - u1));
+                                dirX[lane] = d.x();
+                                dirY[lane] = d.y();
+                                dirZ[lane] = d.z();
+                            }
+                            const unsigned int hits =
+                                    bvh.occluded4(origin, dirX, dirY, dirZ, maxDistance);
+                            unoccluded += 4 - ((hits & 1) + ((hits >> 1) & 1)
+                                               + ((hits >> 2) & 1) + ((hits >> 3) & 1));
+                        }
+                        passVisible[v] = unoccluded;
+                    }
+                }
+            },
+            1);
+
+    if (cancelled)
+        return 0;
+    parallelFor(0, count, [&](size_t first, size_t last) {
+        for (size_t v = first; v < last; ++v)
+            visible[v] += passVisible[v];
+    });
+    samples += 4 * packets;
+    const size_t rays = count * 4 * packets;
+    lastRaysPerSecond = rays / std::max(timer.nsecsElapsed() * 1e-9, 1e-9);
+    return rays;
+}
+
+vector<Vec3f> AmbientOcclusionBake::colors() const
+{
+    vector<Vec3f> result(visible.size(), Vec3f(1.f));
+    if (samples == 0)
+        return result;
+    const float scale = 1.f / samples;
+    parallelFor(0, visible.size(), [&](size_t first, size_t last) {
+        for (size_t v = first; v < last; ++v)
+            result[v] = Vec3f(visible[v] * scale);
+    });
+    return result;
+}
@@ -0,0 +1,92 @@
+// ========================================================================= //
+// Content: BVH ray caster and per-vertex ambient occlusion bake             //
+// ========================================================================= //
+
+#ifndef AMBIENTOCCLUSION_H
+#define AMBIENTOCCLUSION_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <QtGlobal>
+
+#include "vec3.h"
+
+using namespace std;
+
+// Bounding volume hierarchy over triangles (binned SAH, up to 4 triangles per leaf) answering
+// occlusion queries for packets of four rays with a common origin.
+class TriangleBVH
+{
+public:
+    void build(const vector<Vec3f> &vertices, const vector<Vec3i> &triangles);
+    bool empty() const { return nodes.empty(); }
+    size_t nodeCount() const { return nodes.size(); }
+
+    // bit i of activeMask selects the ray (dirX[i], dirY[i], dirZ[i]). returns the mask of the
+    // selected rays that hit a triangle at a distance in (0, maxDistance). the traversal stops
+    // as soon as all selected rays are occluded.
+    unsigned int occluded4(const Vec3f &origin, const float dirX[4], const float dirY[4],
+                           const float dirZ[4], float maxDistance,
+                           unsigned int activeMask = 0xf) const;
+
+private:
+    // inner nodes: the left child follows the node, the right child is at index first.
+    // leaves: count triangles starting at first.
+    struct Node
+    {
+        float bboxMin[3];
+        uint32_t first;
+        float bboxMax[3];
+        uint32_t count;
+    };
+    vector<Node> nodes;
+    // triangles in leaf order as first vertex and the two edges leaving it
+    vector<Vec3f> corners, edges1, edges2;
+
+    struct BuildState;
+    void buildNode(BuildState &state, uint32_t first, uint32_t count, unsigned int depth);
+};
+
+// Progressive per-vertex ambient occlusion: every refine() casts more cosine distributed rays
+// from each vertex over the hemisphere of its normal against a BVH of the mesh itself. the
+// occlusion is the fraction of rays hitting the mesh within maxDistance.
+class AmbientOcclusionBake
+{
+public:
+    // copies the mesh, the BVH is built by the first refine(). a maxDistance <= 0 selects a
+    // quarter of the bounding box diagonal.
+    AmbientOcclusionBake(const vector<Vec3f> &vertices, const vector<Vec3f> &normals,
+                         const vector<Vec3i> &triangles, float maxDistance = 0.f);
+
+    // casts raysPerVertex (rounded up to packets of four) more rays from every vertex on all
+    // cores. returns the number of rays cast, 0 if the bake was cancelled.
+    size_t refine(unsigned int raysPerVertex);
+    // makes a running or later refine() return early without changing the result
+    void cancel() { cancelled = true; }
+
+    unsigned int samplesPerVertex() const { return samples; }
+    // gray vertex colors: 1 for unoccluded, 0 for fully occluded vertices
+    vector<Vec3f> colors() const;
+
+    qint64 buildMilliseconds() const { return buildTime; }
+    // throughput of the last refine()
+    double raysPerSecond() const { return lastRaysPerSecond; }
+
+private:
+    vector<Vec3f> vertices;
+    vector<Vec3f> normals;
+    vector<Vec3i> triangles;
+    TriangleBVH bvh;
+    float maxDistance;
+    float originOffset;
+    // unoccluded rays per vertex
+    vector<uint32_t> visible;
+    unsigned int samples = 0;
+    qint64 buildTime = 0;
+    double lastRaysPerSecond = 0.0;
+    std::atomic<bool> cancelled { false };
+};
+
+#endif // AMBIENTOCCLUSION_H
@@ -0,0 +1,169 @@
+// ========================================================================= //
+// Content: Recorded camera paths, replay frame timings and regression check //
+// ========================================================================= //
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+
+#include "camerapath.h"
+
+namespace {
+
+const char *const PATH_HEADER = "camerapath 1";
+const char *const TYPE_NAMES[] = { "move", "rotate", "light", "reset" };
+
+} // namespace
+
+// ===================
+// === CAMERA PATH ===
+// ===================
+
+bool CameraPath::save(const char *filename) const
+{
+    ofstream out(filename);
+    if (!out.is_open())
+        return false;
+    // enough digits to restore every float exactly
+    out << setprecision(9);
+    out << PATH_HEADER << '\n';
+    out << "initial " << initial.centerPos.x() << ' ' << initial.centerPos.y() << ' '
+        << initial.centerPos.z() << ' ' << initial.angleX << ' ' << initial.angleY << ' '
+        << initial.lightPos.x() << ' ' << initial.lightPos.y() << ' ' << initial.lightPos.z()
+        << ' ' << initial.lightMoves << '\n';
+    for (const auto &event : pathEvents) {
+        out << setprecision(12) << event.time << setprecision(9) << ' ' << TYPE_NAMES[event.type]
+            << ' ' << event.x << ' ' << event.y << ' ' << event.z << '\n';
+    }
+    return bool(out);
+}
+
+bool CameraPath::load(const char *filename)
+{
+    pathEvents.clear();
+    ifstream in(filename);
+    string line;
+    if (!in.is_open() || !getline(in, line) || line != PATH_HEADER)
+        return false;
+
+    string keyword;
+    CameraState state;
+    if (!getline(in, line))
+        return false;
+    istringstream initialLine(line);
+    initialLine >> keyword >> state.centerPos[0] >> state.centerPos[1] >> state.centerPos[2]
+            >> state.angleX >> state.angleY >> state.lightPos[0] >> state.lightPos[1]
+            >> state.lightPos[2] >> state.lightMoves;
+    if (!initialLine || keyword != "initial")
+        return false;
+
+    vector<CameraEvent> loaded;
+    while (getline(in, line)) {
+        if (line.empty())
+            continue;
+        istringstream eventLine(line);
+        CameraEvent event;
+        string type;
+        eventLine >> event.time >> type >> event.x >> event.y >> event.z;
+        const auto name = find(begin(TYPE_NAMES), end(TYPE_NAMES), type);
+        if (!eventLine || name == end(TYPE_NAMES)
+            || (!loaded.empty() && event.time < loaded.back().time))
+            return false;
+        event.type = static_cast<CameraEvent::Type>(name - begin(TYPE_NAMES));
+        loaded.push_back(event);
+    }
+    initial = state;
+    pathEvents.swap(loaded);
+    return true;
+}
+
+// =====================
+// === FRAME TIMINGS ===
+// =====================
+
+double FrameTimings::mean() const
+{
+    if (frameMs.empty())
+        return 0.0;
+    return accumulate(frameMs.begin(), frameMs.end(), 0.0) / frameMs.size();
+}
+
+double FrameTimings::max() const
+{
+    return frameMs.empty() ? 0.0 : *max_element(frameMs.begin(), frameMs.end());
+}
+
+double FrameTimings::percentile(double p) const
+{
+    if (frameMs.empty())
+        return 0.0;
+    vector<double> sorted = frameMs;
+    const size_t rank = static_cast<size_t>(ceil(std::min(std::max(p, 0.0), 100.0) / 100.0
+                                                 * sorted.size()));
+    const size_t index = rank == 0 ? 0 : rank - 1;
+    nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index];
+}
+
+bool FrameTimings::saveCsv(const char *filename) const
+{
+    ofstream out(filename);
+    if (!out.is_open())
+        return false;
+    out << "frame,ms\n" << fixed << setprecision(4);
+    for (size_t i = 0; i < frameMs.size(); ++i)
+        out << i << ',' << frameMs[i] << '\n';
+    return bool(out);
+}
+
+bool FrameTimings::loadCsv(const char *filename)
+{
+    frameMs.clear();
+    ifstream in(filename);
+    string line;
+    if (!in.is_open() || !getline(in, line))
+        return false;
+    while (getline(in, line)) {
+        const size_t comma = line.find(',');
+        if (comma == string::npos)
+            continue;
+        istringstream value(line.substr(comma + 1));
+        double ms;
+        if (value >> ms)
+            frameMs.push_back(ms);
+    }
+    return !frameMs.empty();
+}
+
+vector<string> checkFrameTimings(const FrameTimings &run, const FrameTimings *baseline,
+                                 const FrameTimingThresholds &thresholds)
+{
+    vector<string> failures;
+    const auto fail = [&](const string &what, double value, double limit) {
+        ostringstream message;
+        message << fixed << setprecision(3) << what << ' ' << value << " ms exceeds " << limit
+                << " ms";
+        failures.push_back(message.str());
+    };
+    if (run.frameMs.empty()) {
+        failures.push_back("no frames were timed");
+        return failures;
+    }
+
+    const double mean = run.mean(), p95 = run.percentile(95.0);
+    if (thresholds.maxMeanMs > 0.0 && mean > thresholds.maxMeanMs)
+        fail("mean frame time", mean, thresholds.maxMeanMs);
+    if (thresholds.maxP95Ms > 0.0 && p95 > thresholds.maxP95Ms)
+        fail("95th percentile frame time", p95, thresholds.maxP95Ms);
+    if (baseline && !baseline->frameMs.empty() && thresholds.maxRegressionPercent > 0.0) {
+        const double factor = 1.0 + thresholds.maxRegressionPercent / 100.0;
+        if (mean > baseline->mean() * factor)
+            fail("mean frame time", mean, baseline->mean() * factor);
+        if (p95 > baseline->percentile(95.0) * factor)
+            fail("95th percentile frame time", p95, baseline->percentile(95.0) * factor);
+    }
+    return failures;
+}
@@ -0,0 +1,86 @@
+// ========================================================================= //
+// Content: Recorded camera paths, replay frame timings and regression check //
+// ========================================================================= //
+
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include <string>
+#include <vector>
+
+#include "vec3.h"
+
+using namespace std;
+
+// camera and light state a recording starts from
+struct CameraState
+{
+    Vec3f centerPos;
+    float angleX = 0.f;
+    float angleY = 0.f;
+    Vec3f lightPos;
+    bool lightMoves = false;
+};
+
+// one interaction: a camera move or rotation (deltas in x, y, z), switching the light movement
+// (x != 0 means on) or a reset to the default view
+struct CameraEvent
+{
+    enum Type { Move, Rotate, Light, Reset };
+
+    // milliseconds since the start of the recording
+    double time = 0.0;
+    Type type = Move;
+    float x = 0.f, y = 0.f, z = 0.f;
+};
+
+// Interaction trace of a session: the initial state and the timestamped events in order.
+// stored as text, one event per line.
+class CameraPath
+{
+public:
+    CameraState initial;
+
+    void clear() { pathEvents.clear(); }
+    bool empty() const { return pathEvents.empty(); }
+    void add(const CameraEvent &event) { pathEvents.push_back(event); }
+    const vector<CameraEvent> &events() const { return pathEvents; }
+    // time of the last event in milliseconds
+    double duration() const { return pathEvents.empty() ? 0.0 : pathEvents.back().time; }
+
+    bool save(const char *filename) const;
+    // returns false (and leaves the path empty) for missing or malformed files
+    bool load(const char *filename);
+
+private:
+    vector<CameraEvent> pathEvents;
+};
+
+// Frame times of a replay in milliseconds. saved as CSV with the columns frame and ms.
+struct FrameTimings
+{
+    vector<double> frameMs;
+
+    double mean() const;
+    double max() const;
+    // nearest rank percentile, p in [0, 100]
+    double percentile(double p) const;
+
+    bool saveCsv(const char *filename) const;
+    bool loadCsv(const char *filename);
+};
+
+// limits for a replay, values <= 0 are not checked. the regression limits compare mean and
+// 95th percentile against a baseline run and are given in percent.
+struct FrameTimingThresholds
+{
+    double maxMeanMs = 0.0;
+    double maxP95Ms = 0.0;
+    double maxRegressionPercent = 0.0;
+};
+
+// returns one message per violated threshold, empty if the run passed. baseline may be null.
+vector<string> checkFrameTimings(const FrameTimings &run, const FrameTimings *baseline,
+                                 const FrameTimingThresholds &thresholds);
+
+#endif // CAMERAPATH_H
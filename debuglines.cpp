@@ -0,0 +1,98 @@
+// ========================================================================= //
+// Content: Batched colored debug lines (axes, boxes, normals)               //
+// ========================================================================= //
+
+#include <cstddef>
+
+#include "debuglines.h"
+#include "parallel.h"
+
+void DebugLines::clear()
+{
+    lineVertices.clear();
+    bufferDirty = true;
+}
+
+void DebugLines::addLine(const Vec3f &from, const Vec3f &to, const Vec3f &color)
+{
+    lineVertices.push_back({ from, color });
+    lineVertices.push_back({ to, color });
+    bufferDirty = true;
+}
+
+void DebugLines::addAxes(float length)
+{
+    addLine(Vec3f(0.f), Vec3f(length, 0.f, 0.f), Vec3f(1.f, 0.f, 0.f));
+    addLine(Vec3f(0.f), Vec3f(0.f, length, 0.f), Vec3f(0.f, 1.f, 0.f));
+    addLine(Vec3f(0.f), Vec3f(0.f, 0.f, length), Vec3f(0.f, 0.f, 1.f));
+}
+
+void DebugLines::addBox(const Vec3f &boxMin, const Vec3f &boxMax, const Vec3f &color)
+{
+    const auto corner = [&](unsigned int i) {
+        return Vec3f((i & 1) ? boxMax.x() : boxMin.x(), (i & 2) ? boxMax.y() : boxMin.y(),
+                     (i & 4) ? boxMax.z() : boxMin.z());
+    };
+    // connect every corner with the corners that differ in exactly one axis
+    for (unsigned int i = 0; i < 8; ++i) {
+        for (unsigned int axisBit = 1; axisBit < 8; axisBit <<= 1) {
+            if (!(i & axisBit))
+                addLine(corner(i), corner(i | axisBit), color);
+        }
+    }
+}
+
+void DebugLines::addNormals(const vector<Vec3f> &points, const vector<Vec3f> &normals,
+                            float length, const Vec3f &color, const Vec3f &offset)
+{
+    const size_t count = std::min(points.size(), normals.size());
+    const size_t base = lineVertices.size();
+    lineVertices.resize(base + 2 * count);
+    LineVertex *out = lineVertices.data() + base;
+    parallelFor(0, count, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const Vec3f from = points[i] + offset;
+            out[2 * i] = { from, color };
+            out[2 * i + 1] = { from + normals[i] * length, color };
+        }
+    });
+    bufferDirty = true;
+}
+
+void DebugLines::draw(QOpenGLFunctions_2_1 *f)
+{
+    if (lineVertices.empty())
+        return;
+
+    if (vertexBuffer == 0) {
+        f->glGenBuffers(1, &vertexBuffer);
+        bufferDirty = true;
+    }
+    f->glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    if (bufferDirty) {
+        f->glBufferData(GL_ARRAY_BUFFER, lineVertices.size() * sizeof(LineVertex),
+                        lineVertices.data(), GL_STATIC_DRAW);
+        bufferDirty = false;
+    }
+
+    const GLsizei stride = sizeof(LineVertex);
+    f->glEnableClientState(GL_VERTEX_ARRAY);
+    f->glEnableClientState(GL_COLOR_ARRAY);
+    f->glVertexPointer(3, GL_FLOAT, stride,
+                       reinterpret_cast<const void *>(offsetof(LineVertex, position)));
+    f->glColorPointer(3, GL_FLOAT, stride,
+                      reinterpret_cast<const void *>(offsetof(LineVertex, color)));
+    f->glDrawArrays(GL_LINES, 0, static_cast<GLsizei>(lineVertices.size()));
+    f->glDisableClientState(GL_COLOR_ARRAY);
+    f->glDisableClientState(GL_VERTEX_ARRAY);
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void DebugLines::releaseBuffers(QOpenGLFunctions_2_1 *f)
+{
+    if (vertexBuffer == 0)
+        return;
+    f->glDeleteBuffers(1, &vertexBuffer);
+    vertexBuffer = 0;
+    bufferDirty = true;
+}
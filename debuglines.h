@@ -0,0 +1,58 @@
+// ========================================================================= //
+// Content: Batched colored debug lines (axes, boxes, normals)               //
+// ========================================================================= //
+
+#ifndef DEBUGLINES_H
+#define DEBUGLINES_H
+
+#include <vector>
+
+#include <QOpenGLFunctions_2_1>
+
+#include "vec3.h"
+
+using namespace std;
+
+// Collects colored lines in one interleaved buffer which is uploaded once after a change and
+// drawn with a single glDrawArrays call.
+class DebugLines
+{
+public:
+    struct LineVertex
+    {
+        Vec3f position;
+        Vec3f color;
+    };
+
+    DebugLines() = default;
+    // the GL buffer name is owned by this object, a copy would delete it a second time
+    DebugLines(const DebugLines &) = delete;
+    DebugLines &operator=(const DebugLines &) = delete;
+
+    void clear();
+    bool empty() const { return lineVertices.empty(); }
+    size_t lineCount() const { return lineVertices.size() / 2; }
+
+    void addLine(const Vec3f &from, const Vec3f &to, const Vec3f &color);
+    // red X, green Y and blue Z axis starting in the origin
+    void addAxes(float length);
+    // the 12 edges of an axis aligned box
+    void addBox(const Vec3f &boxMin, const Vec3f &boxMax, const Vec3f &color);
+    // one line per point along its normal, generated in parallel. offset moves all lines, so
+    // the points need not be copied to place them.
+    void addNormals(const vector<Vec3f> &points, const vector<Vec3f> &normals, float length,
+                    const Vec3f &color, const Vec3f &offset = Vec3f());
+
+    // upload (if changed) and draw all lines. lighting should be disabled.
+    void draw(QOpenGLFunctions_2_1 *f);
+
+    // delete the GPU buffer, needs a current context
+    void releaseBuffers(QOpenGLFunctions_2_1 *f);
+
+private:
+    vector<LineVertex> lineVertices;
+    GLuint vertexBuffer = 0;
+    bool bufferDirty = true;
+};
+
+#endif // DEBUGLINES_H
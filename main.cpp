@@ -10,9 +10,12 @@
 // ========================================================================= //
 
 #include "mainwindow.h"
+#include "openglview.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QSurfaceFormat>
+#include <QtDebug>
 
 int main(int argc, char *argv[])
 {
@@ -28,7 +31,81 @@ int main(int argc, char *argv[])
     QSurfaceFormat::setDefaultFormat(format);
 
     QApplication a(argc, argv);
+
+    // benchmark mode: record the interaction of a session, or replay it with a fixed timestep,
+    // write the frame times and fail (exit code 1) if they exceed the thresholds
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    const QCommandLineOption meshOption(
+            "mesh", "Show <file> (OBJ, LSA or CMSH) instead of the default mesh.", "file");
+    const QCommandLineOption recordOption(
+            "record", "Record camera and light events, written to <file> on exit.", "file");
+    const QCommandLineOption replayOption(
+            "replay", "Replay the camera path <file> and quit afterwards.", "file");
+    const QCommandLineOption stepOption(
+            "step", "Fixed timestep of the replay in milliseconds (default 16.667).", "ms",
+            "16.667");
+    const QCommandLineOption timingsOption(
+            "timings", "Write the frame times of the replay to the CSV <file>.", "file");
+    const QCommandLineOption maxMeanOption(
+            "max-mean-ms", "Fail if the mean frame time exceeds <ms>.", "ms");
+    const QCommandLineOption maxP95Option(
+            "max-p95-ms", "Fail if the 95th percentile frame time exceeds <ms>.", "ms");
+    const QCommandLineOption baselineOption(
+            "baseline", "Frame time CSV <file> of a reference replay.", "file");
+    const QCommandLineOption maxRegressionOption(
+            "max-regression",
+            "Fail if mean or 95th percentile are more than <percent> slower than the baseline.",
+            "percent", "10");
+    parser.addOptions({ meshOption, recordOption, replayOption, stepOption, timingsOption,
+                        maxMeanOption, maxP95Option, baselineOption, maxRegressionOption });
+    parser.process(a);
+
     MainWindow w;
+    OpenGLView *view = w.openGLView();
+    if (parser.isSet(meshOption))
+        view->loadMesh(parser.value(meshOption));
+
+    if (parser.isSet(recordOption)) {
+        const QString pathFile = parser.value(recordOption);
+        view->startRecording();
+        QObject::connect(&a, &QCoreApplication::aboutToQuit, [view, pathFile]() {
+            if (!view->stopRecording().save(qPrintable(pathFile)))
+                qWarning("Can not write camera path %s", qPrintable(pathFile));
+        });
+    }
+
+    if (parser.isSet(replayOption)) {
+        CameraPath path;
+        if (!path.load(qPrintable(parser.value(replayOption)))) {
+            qCritical("Can not read camera path %s", qPrintable(parser.value(replayOption)));
+            return 2;
+        }
+        FrameTimings baseline;
+        const bool hasBaseline = parser.isSet(baselineOption);
+        if (hasBaseline && !baseline.loadCsv(qPrintable(parser.value(baselineOption)))) {
+            qCritical("Can not read baseline %s", qPrintable(parser.value(baselineOption)));
+            return 2;
+        }
+        FrameTimingThresholds thresholds;
+        thresholds.maxMeanMs = parser.value(maxMeanOption).toDouble();
+        thresholds.maxP95Ms = parser.value(maxP95Option).toDouble();
+        thresholds.maxRegressionPercent = parser.value(maxRegressionOption).toDouble();
+        const QString timingsFile = parser.value(timingsOption);
+
+        const auto finishReplay = [=](const FrameTimings &timings) {
+            if (!timingsFile.isEmpty() && !timings.saveCsv(qPrintable(timingsFile)))
+                qWarning("Can not write frame times %s", qPrintable(timingsFile));
+            const vector<string> failures =
+                    checkFrameTimings(timings, hasBaseline ? &baseline : nullptr, thresholds);
+            for (const auto &failure : failures)
+                qCritical("Frame time regression: %s", failure.c_str());
+            QCoreApplication::exit(failures.empty() ? 0 : 1);
+        };
+        QObject::connect(view, &OpenGLView::replayFinished, &a, finishReplay);
+        view->startReplay(path, parser.value(stepOption).toDouble());
+    }
+
     w.show();
     return a.exec();
 }
@@ -18,7 +18,27 @@
 
 void MainWindow::refreshStatusBarMessage() const
 {
-    statusBar()->showMessage(tr("FPS: %1, Triangles: %2").arg(fpsCount).arg(triangleCount));
+    const Vec3f size = meshStatistics.bboxMax - meshStatistics.bboxMin;
+    QString triangles = QString::number(triangleCount);
+    if (visibleTriangleCount + culledTriangleCount > 0) {
+        triangles += tr(" (visible %1, culled %2)")
+                             .arg(visibleTriangleCount)
+                             .arg(culledTriangleCount);
+    }
+    statusBar()->showMessage(
+            tr("FPS: %1, Triangles: %2 | Size: %3 x %4 x %5, Area: %6, Volume: %7, "
+               "Edge length: %8 - %9 (mean %10), Degenerate: %11")
+                    .arg(fpsCount)
+                    .arg(triangles)
+                    .arg(size.x(), 0, 'g', 4)
+                    .arg(size.y(), 0, 'g', 4)
+                    .arg(size.z(), 0, 'g', 4)
+                    .arg(meshStatistics.surfaceArea, 0, 'g', 4)
+                    .arg(meshStatistics.volume, 0, 'g', 4)
+                    .arg(meshStatistics.minEdgeLength, 0, 'g', 3)
+                    .arg(meshStatistics.maxEdgeLength, 0, 'g', 3)
+                    .arg(meshStatistics.meanEdgeLength, 0, 'g', 3)
+                    .arg(meshStatistics.degenerateTriangles));
 }
 
 void MainWindow::changeTriangleCount(unsigned int triangles)
@@ -27,18 +47,44 @@ void MainWindow::changeTriangleCount(unsigned int triangles)
     refreshStatusBarMessage();
 }
 
+void MainWindow::changeCullingStatistics(unsigned int visibleTriangles,
+                                         unsigned int culledTriangles)
+{
+    visibleTriangleCount = visibleTriangles;
+    culledTriangleCount = culledTriangles;
+    refreshStatusBarMessage();
+}
+
 void MainWindow::changeFpsCount(unsigned int fps)
 {
     fpsCount = fps;
     refreshStatusBarMessage();
 }
 
+void MainWindow::changeMeshStatistics(const MeshStatistics &statistics)
+{
+    meshStatistics = statistics;
+    refreshStatusBarMessage();
+}
+
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
     connect(ui->exitButton, &QPushButton::clicked, qApp, &QApplication::exit);
     connect(ui->lightMovementCheckBox, &QCheckBox::clicked, ui->openGLWidget,
             &OpenGLView::triggerLightMovement);
+    connect(ui->openGLWidget, &OpenGLView::lightMovementChanged, ui->lightMovementCheckBox,
+            &QCheckBox::setChecked);
+    connect(ui->pointCloudCheckBox, &QCheckBox::clicked, ui->openGLWidget,
+            &OpenGLView::showPointCloud);
+    connect(ui->openGLWidget, &OpenGLView::pointCloudModeChanged, ui->pointCloudCheckBox,
+            &QCheckBox::setChecked);
+    connect(ui->normalsCheckBox, &QCheckBox::clicked, ui->openGLWidget,
+            &OpenGLView::showNormals);
+    connect(ui->occlusionCullingCheckBox, &QCheckBox::clicked, ui->openGLWidget,
+            &OpenGLView::enableOcclusionCulling);
+    connect(ui->scanTriangulationCheckBox, &QCheckBox::clicked, ui->openGLWidget,
+            &OpenGLView::enableScanTriangulation);
     connect(ui->resetViewButton, &QPushButton::clicked, ui->openGLWidget, &OpenGLView::setDefaults);
 
     connect(ui->recalcNormalsByAngleButton, &QPushButton::clicked,
@@ -46,9 +92,26 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
     connect(ui->recalcNormalsByAreaButton, &QPushButton::clicked,
             std::bind(&OpenGLView::recalcNormals, ui->openGLWidget, false));
 
+    connect(ui->smoothUniformButton, &QPushButton::clicked,
+            std::bind(&OpenGLView::smoothMesh, ui->openGLWidget, false, false));
+    connect(ui->smoothCotangentButton, &QPushButton::clicked,
+            std::bind(&OpenGLView::smoothMesh, ui->openGLWidget, true, false));
+    connect(ui->smoothTaubinButton, &QPushButton::clicked,
+            std::bind(&OpenGLView::smoothMesh, ui->openGLWidget, false, true));
+    connect(ui->subdivideButton, &QPushButton::clicked,
+            std::bind(&OpenGLView::subdivideMesh, ui->openGLWidget, false));
+    connect(ui->subdivideAdaptiveButton, &QPushButton::clicked,
+            std::bind(&OpenGLView::subdivideMesh, ui->openGLWidget, true));
+    connect(ui->bakeAmbientOcclusionButton, &QPushButton::clicked, ui->openGLWidget,
+            &OpenGLView::bakeAmbientOcclusion);
+
     connect(ui->openGLWidget, &OpenGLView::triangleCountChanged, this,
             &MainWindow::changeTriangleCount);
+    connect(ui->openGLWidget, &OpenGLView::cullingStatisticsChanged, this,
+            &MainWindow::changeCullingStatistics);
     connect(ui->openGLWidget, &OpenGLView::fpsCountChanged, this, &MainWindow::changeFpsCount);
+    connect(ui->openGLWidget, &OpenGLView::meshStatisticsChanged, this,
+            &MainWindow::changeMeshStatistics);
 
     statusBar()->showMessage(tr("OpenGL-Fenster geöffnet."));
 }
@@ -58,6 +121,11 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
+OpenGLView *MainWindow::openGLView() const
+{
+    return ui->openGLWidget;
+}
+
 void MainWindow::mousePressEvent(QMouseEvent *ev)
 {
     mousePos = ev->pos();
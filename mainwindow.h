@@ -15,6 +15,10 @@
 #include <QPoint>
 #include <QMainWindow>
 
+#include "trianglemesh.h"
+
+class OpenGLView;
+
 QT_BEGIN_NAMESPACE
 namespace Ui {
 class MainWindow;
@@ -28,11 +32,15 @@ class MainWindow : public QMainWindow
 public slots:
     void changeTriangleCount(unsigned int triangles);
     void changeFpsCount(unsigned int fps);
+    void changeMeshStatistics(const MeshStatistics &statistics);
+    void changeCullingStatistics(unsigned int visibleTriangles, unsigned int culledTriangles);
 
 public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    OpenGLView *openGLView() const;
+
 protected:
     void mousePressEvent(QMouseEvent *ev) override;
     void mouseMoveEvent(QMouseEvent *ev) override;
@@ -41,6 +49,10 @@ private:
     Ui::MainWindow *ui;
     unsigned int fpsCount = 0;
     unsigned int triangleCount = 0;
+    // occlusion culling result of the last frame, both 0 if culling is off
+    unsigned int visibleTriangleCount = 0;
+    unsigned int culledTriangleCount = 0;
+    MeshStatistics meshStatistics;
     void refreshStatusBarMessage() const;
 
     // mouse information
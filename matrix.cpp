@@ -0,0 +1,169 @@
+// ========================================================================= //
+// Content: 3x3/4x4 matrices, quaternions and batched vertex transforms      //
+// ========================================================================= //
+
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64)
+#    include <xmmintrin.h>
+#    define MATRIX_USE_SSE
+#endif
+
+#include "matrix.h"
+
+#ifdef MATRIX_USE_SSE
+namespace {
+
+static_assert(sizeof(Vec3f) == 3 * sizeof(float), "the SSE kernels need tightly packed Vec3f");
+
+// The SSE kernels work on 4 vertices per iteration: the 12 floats x0 y0 z0 x1 .. z3 are loaded
+// as three registers, transposed into x, y and z of all four and transformed with broadcast
+// matrix entries, so every lane does useful work. the remainder runs the scalar code.
+inline void loadTransposed(const Vec3f *in, __m128 &x, __m128 &y, __m128 &z)
+{
+    const float *p = reinterpret_cast<const float *>(in);
+    const __m128 a = _mm_loadu_ps(p);     // x0 y0 z0 x1
+    const __m128 b = _mm_loadu_ps(p + 4); // y1 z1 x2 y2
+    const __m128 c = _mm_loadu_ps(p + 8); // z2 x3 y3 z3
+    const __m128 bc = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2)); // x2 y2 x3 y3
+    x = _mm_shuffle_ps(a, bc, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 0, 1)), bc,
+                       _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                       _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+inline void storeTransposed(Vec3f *out, __m128 x, __m128 y, __m128 z)
+{
+    float *p = reinterpret_cast<float *>(out);
+    _mm_storeu_ps(p, _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+                                    _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)),
+                                    _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(p + 4, _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+                                        _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)),
+                                        _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(p + 8, _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+                                        _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)),
+                                        _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+} // namespace
+#endif
+
+void transformPoints(const Mat4f &m, const Vec3f *in, Vec3f *out, size_t count)
+{
+    size_t i = 0;
+#ifdef MATRIX_USE_SSE
+    const float *d = m.constData();
+    __m128 e[12];
+    for (unsigned int c = 0; c < 4; ++c) {
+        for (unsigned int r = 0; r < 3; ++r)
+            e[3 * c + r] = _mm_set1_ps(d[4 * c + r]);
+    }
+    for (; i + 4 <= count; i += 4) {
+        __m128 x, y, z;
+        loadTransposed(in + i, x, y, z);
+        __m128 result[3];
+        for (unsigned int r = 0; r < 3; ++r) {
+            result[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e[r], x), _mm_mul_ps(e[3 + r], y)),
+                                   _mm_add_ps(_mm_mul_ps(e[6 + r], z), e[9 + r]));
+        }
+        storeTransposed(out + i, result[0], result[1], result[2]);
+    }
+#endif
+    for (; i < count; ++i)
+        out[i] = m.transformPoint(in[i]);
+}
+
+void transformDirections(const Mat3f &m, const Vec3f *in, Vec3f *out, size_t count,
+                         bool normalize)
+{
+    size_t i = 0;
+#ifdef MATRIX_USE_SSE
+    const float *d = m.constData();
+    __m128 e[9];
+    for (unsigned int k = 0; k < 9; ++k)
+        e[k] = _mm_set1_ps(d[k]);
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 minLength2 = _mm_set1_ps(EPS * EPS);
+    for (; i + 4 <= count; i += 4) {
+        __m128 x, y, z;
+        loadTransposed(in + i, x, y, z);
+        __m128 result[3];
+        for (unsigned int r = 0; r < 3; ++r) {
+            result[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e[r], x), _mm_mul_ps(e[3 + r], y)),
+                                   _mm_mul_ps(e[6 + r], z));
+        }
+        if (normalize) {
+            // normalized in the same pass, vectors shorter than EPS stay as they are like in
+            // Vec3::normalize()
+            const __m128 length2 = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(result[0], result[0]), _mm_mul_ps(result[1], result[1])),
+                    _mm_mul_ps(result[2], result[2]));
+            const __m128 valid = _mm_cmpge_ps(length2, minLength2);
+            const __m128 scale = _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(one, _mm_sqrt_ps(length2))),
+                                           _mm_andnot_ps(valid, one));
+            for (unsigned int r = 0; r < 3; ++r)
+                result[r] = _mm_mul_ps(result[r], scale);
+        }
+        storeTransposed(out + i, result[0], result[1], result[2]);
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = m * in[i];
+        if (normalize)
+            out[i].normalize();
+    }
+}
+
+void extendBounds(const Vec3f *points, size_t count, Vec3f &outMin, Vec3f &outMax)
+{
+    size_t i = 0;
+#ifdef MATRIX_USE_SSE
+    if (count >= 4) {
+        __m128 lo[3], hi[3];
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            lo[axis] = _mm_set1_ps(outMin[axis]);
+            hi[axis] = _mm_set1_ps(outMax[axis]);
+        }
+        for (; i + 4 <= count; i += 4) {
+            __m128 p[3];
+            loadTransposed(points + i, p[0], p[1], p[2]);
+            for (unsigned int axis = 0; axis < 3; ++axis) {
+                lo[axis] = _mm_min_ps(lo[axis], p[axis]);
+                hi[axis] = _mm_max_ps(hi[axis], p[axis]);
+            }
+        }
+        alignas(16) float lanes[2][4];
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            _mm_store_ps(lanes[0], lo[axis]);
+            _mm_store_ps(lanes[1], hi[axis]);
+            outMin[axis] = std::min(std::min(lanes[0][0], lanes[0][1]),
+                                    std::min(lanes[0][2], lanes[0][3]));
+            outMax[axis] = std::max(std::max(lanes[1][0], lanes[1][1]),
+                                    std::max(lanes[1][2], lanes[1][3]));
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            outMin[axis] = std::min(outMin[axis], points[i][axis]);
+            outMax[axis] = std::max(outMax[axis], points[i][axis]);
+        }
+    }
+}
+
+void transformBounds(const Mat4f &m, const Vec3f &bboxMin, const Vec3f &bboxMax, Vec3f &outMin,
+                     Vec3f &outMax)
+{
+    // Arvo: per output axis pick the smaller/larger product of every matrix entry
+    outMin = outMax = m.translation();
+    for (unsigned int r = 0; r < 3; ++r) {
+        for (unsigned int c = 0; c < 3; ++c) {
+            const float a = m(r, c) * bboxMin[c];
+            const float b = m(r, c) * bboxMax[c];
+            outMin[r] += std::min(a, b);
+            outMax[r] += std::max(a, b);
+        }
+    }
+}
@@ -0,0 +1,358 @@
+// ========================================================================= //
+// Content: 3x3/4x4 matrices, quaternions and batched vertex transforms      //
+// ========================================================================= //
+
+#pragma once
+#include <cstddef>
+#include <math.h>
+
+#include "vec3.h"
+
+// 3x3 matrix, stored column major
+template<typename T>
+struct Mat3
+{
+private:
+    T data[9];
+
+public:
+    Mat3() { setIdentity(); }
+    Mat3(const Vec3<T> &c0, const Vec3<T> &c1, const Vec3<T> &c2)
+        : data { c0[0], c0[1], c0[2], c1[0], c1[1], c1[2], c2[0], c2[1], c2[2] }
+    {
+    }
+
+    T operator()(const unsigned int row, const unsigned int col) const
+    {
+        return data[col * 3 + row];
+    }
+    T &operator()(const unsigned int row, const unsigned int col) { return data[col * 3 + row]; }
+    const T *constData() const { return data; }
+    Vec3<T> column(const unsigned int col) const
+    {
+        return Vec3<T>(data[col * 3], data[col * 3 + 1], data[col * 3 + 2]);
+    }
+
+    void setIdentity()
+    {
+        for (unsigned int i = 0; i < 9; ++i)
+            data[i] = (i % 4 == 0) ? T(1) : T(0);
+    }
+
+    friend Mat3 operator*(const Mat3 &a, const Mat3 &b)
+    {
+        Mat3 result;
+        for (unsigned int c = 0; c < 3; ++c)
+            for (unsigned int r = 0; r < 3; ++r)
+                result(r, c) = a(r, 0) * b(0, c) + a(r, 1) * b(1, c) + a(r, 2) * b(2, c);
+        return result;
+    }
+
+    friend Vec3<T> operator*(const Mat3 &m, const Vec3<T> &v)
+    {
+        return Vec3<T>(m(0, 0) * v[0] + m(0, 1) * v[1] + m(0, 2) * v[2],
+                       m(1, 0) * v[0] + m(1, 1) * v[1] + m(1, 2) * v[2],
+                       m(2, 0) * v[0] + m(2, 1) * v[1] + m(2, 2) * v[2]);
+    }
+
+    Mat3 transposed() const
+    {
+        Mat3 result;
+        for (unsigned int c = 0; c < 3; ++c)
+            for (unsigned int r = 0; r < 3; ++r)
+                result(r, c) = (*this)(c, r);
+        return result;
+    }
+
+    T determinant() const { return column(0) * cross(column(1), column(2)); }
+
+    // returns the inverse, or the identity if the matrix is singular
+    Mat3 inverted() const
+    {
+        const Vec3<T> c0 = column(0), c1 = column(1), c2 = column(2);
+        const T det = determinant();
+        if (std::fabs(det) < EPS * EPS)
+            return Mat3();
+        // rows of the inverse are the cross products of the columns
+        const Vec3<T> r0 = cross(c1, c2) / det, r1 = cross(c2, c0) / det, r2 = cross(c0, c1) / det;
+        return Mat3(r0, r1, r2).transposed();
+    }
+
+    // matrix for transforming normals of geometry transformed by this matrix
+    Mat3 normalMatrix() const { return inverted().transposed(); }
+
+    static Mat3 scaling(const Vec3<T> &s)
+    {
+        Mat3 m;
+        m(0, 0) = s[0];
+        m(1, 1) = s[1];
+        m(2, 2) = s[2];
+        return m;
+    }
+
+    // rotation around an arbitrary axis (angle in degree)
+    static Mat3 rotation(const T angle, const Vec3<T> &axis)
+    {
+        const Vec3<T> a = axis.normalized();
+        const T c = cos(angle * M_RadToDeg), s = sin(angle * M_RadToDeg), t = T(1) - c;
+        Mat3 m;
+        m(0, 0) = t * a[0] * a[0] + c;
+        m(0, 1) = t * a[0] * a[1] - s * a[2];
+        m(0, 2) = t * a[0] * a[2] + s * a[1];
+        m(1, 0) = t * a[0] * a[1] + s * a[2];
+        m(1, 1) = t * a[1] * a[1] + c;
+        m(1, 2) = t * a[1] * a[2] - s * a[0];
+        m(2, 0) = t * a[0] * a[2] - s * a[1];
+        m(2, 1) = t * a[1] * a[2] + s * a[0];
+        m(2, 2) = t * a[2] * a[2] + c;
+        return m;
+    }
+};
+
+// 4x4 matrix, stored column major like OpenGL expects it
+template<typename T>
+struct Mat4
+{
+private:
+    T data[16];
+
+public:
+    Mat4() { setIdentity(); }
+    Mat4(const Mat3<T> &m, const Vec3<T> &translation = Vec3<T>())
+    {
+        setIdentity();
+        for (unsigned int c = 0; c < 3; ++c)
+            for (unsigned int r = 0; r < 3; ++r)
+                (*this)(r, c) = m(r, c);
+        for (unsigned int r = 0; r < 3; ++r)
+            (*this)(r, 3) = translation[r];
+    }
+
+    T operator()(const unsigned int row, const unsigned int col) const
+    {
+        return data[col * 4 + row];
+    }
+    T &operator()(const unsigned int row, const unsigned int col) { return data[col * 4 + row]; }
+    const T *constData() const { return data; }
+
+    void setIdentity()
+    {
+        for (unsigned int i = 0; i < 16; ++i)
+            data[i] = (i % 5 == 0) ? T(1) : T(0);
+    }
+
+    friend Mat4 operator*(const Mat4 &a, const Mat4 &b)
+    {
+        Mat4 result;
+        for (unsigned int c = 0; c < 4; ++c)
+            for (unsigned int r = 0; r < 4; ++r)
+                result(r, c) = a(r, 0) * b(0, c) + a(r, 1) * b(1, c) + a(r, 2) * b(2, c)
+                        + a(r, 3) * b(3, c);
+        return result;
+    }
+    Mat4 &operator*=(const Mat4 &m) { return *this = *this * m; }
+
+    // transforms a point (w = 1) and drops the resulting w
+    Vec3<T> transformPoint(const Vec3<T> &v) const
+    {
+        return Vec3<T>(data[0] * v[0] + data[4] * v[1] + data[8] * v[2] + data[12],
+                       data[1] * v[0] + data[5] * v[1] + data[9] * v[2] + data[13],
+                       data[2] * v[0] + data[6] * v[1] + data[10] * v[2] + data[14]);
+    }
+    // transforms a point (w = 1) and returns the homogeneous result in out
+    void transformPoint(const Vec3<T> &v, T out[4]) const
+    {
+        for (unsigned int r = 0; r < 4; ++r)
+            out[r] = data[r] * v[0] + data[4 + r] * v[1] + data[8 + r] * v[2] + data[12 + r];
+    }
+    // transforms a direction (w = 0)
+    Vec3<T> transformVector(const Vec3<T> &v) const { return upperLeft() * v; }
+
+    Mat3<T> upperLeft() const
+    {
+        Mat3<T> m;
+        for (unsigned int c = 0; c < 3; ++c)
+            for (unsigned int r = 0; r < 3; ++r)
+                m(r, c) = (*this)(r, c);
+        return m;
+    }
+    Vec3<T> translation() const { return Vec3<T>(data[12], data[13], data[14]); }
+
+    Mat4 transposed() const
+    {
+        Mat4 result;
+        for (unsigned int c = 0; c < 4; ++c)
+            for (unsigned int r = 0; r < 4; ++r)
+                result(r, c) = (*this)(c, r);
+        return result;
+    }
+
+    // returns the inverse, or the identity if the matrix is singular
+    Mat4 inverted() const
+    {
+        const T *m = data;
+        T inv[16];
+        inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15]
+                + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+        inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15]
+                - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+        inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15]
+                + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+        inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14]
+                - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+        inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15]
+                - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+        inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15]
+                + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+        inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15]
+                - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+        inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14]
+                + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+        inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15]
+                + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+        inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15]
+                - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+        inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15]
+                + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+        inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14]
+                - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+        inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11]
+                - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+        inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11]
+                + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+        inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11]
+                - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+        inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10]
+                + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+        const T det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+        Mat4 result;
+        if (std::fabs(det) < EPS * EPS)
+            return result;
+        for (unsigned int i = 0; i < 16; ++i)
+            result.data[i] = inv[i] / det;
+        return result;
+    }
+
+    static Mat4 translation(const Vec3<T> &t) { return Mat4(Mat3<T>(), t); }
+    static Mat4 scaling(const Vec3<T> &s) { return Mat4(Mat3<T>::scaling(s)); }
+    // rotation around an arbitrary axis (angle in degree), same convention as glRotate
+    static Mat4 rotation(const T angle, const Vec3<T> &axis)
+    {
+        return Mat4(Mat3<T>::rotation(angle, axis));
+    }
+    // projection matrix like gluPerspective (fovy in degree)
+    static Mat4 perspective(const T fovy, const T aspect, const T zNear, const T zFar)
+    {
+        const T f = T(1) / tan(fovy * M_RadToDeg / T(2));
+        Mat4 m;
+        m(0, 0) = f / aspect;
+        m(1, 1) = f;
+        m(2, 2) = (zFar + zNear) / (zNear - zFar);
+        m(2, 3) = T(2) * zFar * zNear / (zNear - zFar);
+        m(3, 2) = T(-1);
+        m(3, 3) = T(0);
+        return m;
+    }
+};
+
+// unit quaternion for rotations, w is the real part
+template<typename T>
+struct Quat
+{
+private:
+    T data[4];
+
+public:
+    Quat() : data { T(1), T(0), T(0), T(0) } { }
+    Quat(const T w, const T x, const T y, const T z) : data { w, x, y, z } { }
+
+    T w() const { return data[0]; }
+    T x() const { return data[1]; }
+    T y() const { return data[2]; }
+    T z() const { return data[3]; }
+    Vec3<T> vec() const { return Vec3<T>(data[1], data[2], data[3]); }
+
+    // rotation around an axis (angle in degree)
+    static Quat fromAxisAngle(const T angle, const Vec3<T> &axis)
+    {
+        const Vec3<T> a = axis.normalized();
+        const T half = angle * M_RadToDeg / T(2);
+        const T s = sin(half);
+        return Quat(cos(half), a[0] * s, a[1] * s, a[2] * s);
+    }
+
+    friend Quat operator*(const Quat &a, const Quat &b)
+    {
+        return Quat(a.w() * b.w() - a.x() * b.x() - a.y() * b.y() - a.z() * b.z(),
+                    a.w() * b.x() + a.x() * b.w() + a.y() * b.z() - a.z() * b.y(),
+                    a.w() * b.y() - a.x() * b.z() + a.y() * b.w() + a.z() * b.x(),
+                    a.w() * b.z() + a.x() * b.y() - a.y() * b.x() + a.z() * b.w());
+    }
+
+    T length() const { return sqrt(w() * w() + x() * x() + y() * y() + z() * z()); }
+    Quat normalized() const
+    {
+        const T l = length();
+        if (std::fabs(l) < EPS)
+            return Quat();
+        return Quat(w() / l, x() / l, y() / l, z() / l);
+    }
+    Quat conjugated() const { return Quat(w(), -x(), -y(), -z()); }
+
+    // rotates v by this (unit) quaternion
+    Vec3<T> rotate(const Vec3<T> &v) const
+    {
+        const Vec3<T> t = T(2) * cross(vec(), v);
+        return v + w() * t + cross(vec(), t);
+    }
+
+    Mat3<T> toMat3() const
+    {
+        return Mat3<T>(rotate(Vec3<T>(1, 0, 0)), rotate(Vec3<T>(0, 1, 0)),
+                       rotate(Vec3<T>(0, 0, 1)));
+    }
+
+    // spherical linear interpolation between two unit quaternions
+    static Quat slerp(const Quat &a, Quat b, const T t)
+    {
+        T d = a.w() * b.w() + a.x() * b.x() + a.y() * b.y() + a.z() * b.z();
+        if (d < 0) {
+            d = -d;
+            b = Quat(-b.w(), -b.x(), -b.y(), -b.z());
+        }
+        T wa = T(1) - t, wb = t;
+        if (d < T(1) - EPS) {
+            const T angle = acos(d);
+            const T s = sin(angle);
+            wa = sin(wa * angle) / s;
+            wb = sin(wb * angle) / s;
+        }
+        return Quat(wa * a.w() + wb * b.w(), wa * a.x() + wb * b.x(), wa * a.y() + wb * b.y(),
+                    wa * a.z() + wb * b.z())
+                .normalized();
+    }
+};
+
+typedef Mat3<float> Mat3f;
+typedef Mat4<float> Mat4f;
+typedef Quat<float> Quatf;
+
+// ==============================
+// === BATCHED TRANSFORMATION ===
+// ==============================
+
+// transforms count points (w = 1). in and out may be the same array.
+void transformPoints(const Mat4f &m, const Vec3f *in, Vec3f *out, size_t count);
+
+// transforms count directions, e.g. normals with Mat3f::normalMatrix(). in and out may be the
+// same array. optionally renormalizes the results.
+void transformDirections(const Mat3f &m, const Vec3f *in, Vec3f *out, size_t count,
+                         bool normalize = false);
+
+// extends [outMin, outMax] by count points, 4 points per SSE step
+void extendBounds(const Vec3f *points, size_t count, Vec3f &outMin, Vec3f &outMax);
+
+// axis aligned bounding box of the transformed box [bboxMin, bboxMax]
+void transformBounds(const Mat4f &m, const Vec3f &bboxMin, const Vec3f &bboxMax, Vec3f &outMin,
+                     Vec3f &outMax);
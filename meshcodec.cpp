@@ -0,0 +1,672 @@
+// ========================================================================= //
+// Content: Compressed mesh container (CMSH) encoder and decoder             //
+// ========================================================================= //
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "meshcodec.h"
+#include "parallel.h"
+
+namespace {
+
+const unsigned char CMSH_MAGIC[4] = { 'C', 'M', 'S', 'H' };
+const uint32_t CMSH_VERSION = 1;
+const size_t HEADER_SIZE = 4 + 5 * 4 + 6 * 4;
+const size_t CHUNK_ENTRY_SIZE = 4 * 4 + 2 * 8;
+
+struct ChunkInfo
+{
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    uint32_t firstTriangle;
+    uint32_t triangleCount;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// ==========================
+// === BYTE LEVEL HELPERS ===
+// ==========================
+
+void putU32(std::vector<unsigned char> &out, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+        out.push_back(static_cast<unsigned char>(v >> (8 * i)));
+}
+
+void putU64(std::vector<unsigned char> &out, uint64_t v)
+{
+    for (int i = 0; i < 8; ++i)
+        out.push_back(static_cast<unsigned char>(v >> (8 * i)));
+}
+
+void putF32(std::vector<unsigned char> &out, float f)
+{
+    uint32_t u;
+    std::memcpy(&u, &f, sizeof(u));
+    putU32(out, u);
+}
+
+uint32_t getU32(const unsigned char *p)
+{
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+uint64_t getU64(const unsigned char *p)
+{
+    return uint64_t(getU32(p)) | (uint64_t(getU32(p + 4)) << 32);
+}
+
+float getF32(const unsigned char *p)
+{
+    const uint32_t u = getU32(p);
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+void putVarint(std::vector<unsigned char> &out, uint32_t v)
+{
+    while (v >= 0x80) {
+        out.push_back(static_cast<unsigned char>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(v));
+}
+
+uint32_t zigzag(int32_t v)
+{
+    return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31);
+}
+
+int32_t unzigzag(uint32_t v)
+{
+    return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1);
+}
+
+struct VarintReader
+{
+    const unsigned char *pos;
+    const unsigned char *end;
+    bool failed = false;
+
+    uint32_t next()
+    {
+        uint32_t result = 0;
+        for (unsigned int shift = 0; shift < 35; shift += 7) {
+            if (pos == end)
+                break;
+            const unsigned char byte = *pos++;
+            result |= uint32_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return result;
+        }
+        failed = true;
+        return 0;
+    }
+};
+
+// ======================
+// === ENTROPY CODING ===
+// ======================
+
+// Order-0 rANS over the bytes of one varint stream (after Giesen's rans_byte). A block is
+// stored as: varint raw size, mode byte, varint data size, for RANS_MODE 256 varint symbol
+// frequencies summing to RANS_SCALE, then the data bytes.
+const unsigned char STORED_MODE = 0;
+const unsigned char RANS_MODE = 1;
+const uint32_t RANS_PROB_BITS = 12;
+const uint32_t RANS_SCALE = 1u << RANS_PROB_BITS;
+const uint32_t RANS_LOWER = 1u << 23;
+
+// scales the byte histogram to RANS_SCALE, keeping every occurring symbol at least 1
+void normalizeFrequencies(const uint64_t counts[256], uint64_t total, uint32_t freqs[256])
+{
+    uint32_t sum = 0;
+    for (unsigned int s = 0; s < 256; ++s) {
+        freqs[s] = counts[s] == 0 ? 0
+                                  : std::max<uint32_t>(1, static_cast<uint32_t>(
+                                                                  counts[s] * RANS_SCALE / total));
+        sum += freqs[s];
+    }
+    while (sum != RANS_SCALE) {
+        // adjust the most frequent symbol, where it costs the least
+        unsigned int largest = 0;
+        for (unsigned int s = 1; s < 256; ++s) {
+            if (freqs[s] > freqs[largest])
+                largest = s;
+        }
+        if (sum > RANS_SCALE) {
+            const uint32_t step = std::min(sum - RANS_SCALE, freqs[largest] - 1);
+            freqs[largest] -= step;
+            sum -= step;
+        } else {
+            freqs[largest] += RANS_SCALE - sum;
+            sum = RANS_SCALE;
+        }
+    }
+}
+
+void entropyEncode(const std::vector<unsigned char> &raw, std::vector<unsigned char> &out)
+{
+    putVarint(out, static_cast<uint32_t>(raw.size()));
+    if (raw.empty())
+        return;
+
+    uint64_t counts[256] = {};
+    for (unsigned char byte : raw)
+        ++counts[byte];
+    uint32_t freqs[256], starts[256];
+    normalizeFrequencies(counts, raw.size(), freqs);
+    uint32_t start = 0;
+    for (unsigned int s = 0; s < 256; ++s) {
+        starts[s] = start;
+        start += freqs[s];
+    }
+
+    // the decoder reads forward, so encode back to front and reverse the bytes afterwards
+    std::vector<unsigned char> coded;
+    coded.reserve(raw.size() / 2 + 16);
+    uint32_t x = RANS_LOWER;
+    for (size_t i = raw.size(); i-- > 0;) {
+        const uint32_t freq = freqs[raw[i]];
+        const uint32_t xMax = ((RANS_LOWER >> RANS_PROB_BITS) << 8) * freq;
+        while (x >= xMax) {
+            coded.push_back(static_cast<unsigned char>(x & 0xff));
+            x >>= 8;
+        }
+        x = ((x / freq) << RANS_PROB_BITS) + (x % freq) + starts[raw[i]];
+    }
+    for (int shift = 0; shift < 32; shift += 8)
+        coded.push_back(static_cast<unsigned char>(x >> shift));
+    std::reverse(coded.begin(), coded.end());
+
+    std::vector<unsigned char> table;
+    for (unsigned int s = 0; s < 256; ++s)
+        putVarint(table, freqs[s]);
+    if (table.size() + coded.size() >= raw.size()) {
+        out.push_back(STORED_MODE);
+        putVarint(out, static_cast<uint32_t>(raw.size()));
+        out.insert(out.end(), raw.begin(), raw.end());
+        return;
+    }
+    out.push_back(RANS_MODE);
+    putVarint(out, static_cast<uint32_t>(coded.size()));
+    out.insert(out.end(), table.begin(), table.end());
+    out.insert(out.end(), coded.begin(), coded.end());
+}
+
+// decodes the block at in.pos into raw and advances in past it. rejects blocks that would
+// expand beyond maxRawSize.
+bool entropyDecode(VarintReader &in, size_t maxRawSize, std::vector<unsigned char> &raw)
+{
+    const uint32_t rawSize = in.next();
+    if (in.failed || rawSize > maxRawSize)
+        return false;
+    raw.resize(rawSize);
+    if (rawSize == 0)
+        return true;
+    if (in.pos == in.end)
+        return false;
+    const unsigned char mode = *in.pos++;
+    if (mode == STORED_MODE) {
+        if (in.next() != rawSize || in.failed || size_t(in.end - in.pos) < rawSize)
+            return false;
+        std::memcpy(raw.data(), in.pos, rawSize);
+        in.pos += rawSize;
+        return true;
+    }
+    const uint32_t codedSize = in.next();
+    if (mode != RANS_MODE || in.failed)
+        return false;
+
+    uint32_t freqs[256], starts[256];
+    uint32_t start = 0;
+    for (unsigned int s = 0; s < 256; ++s) {
+        freqs[s] = in.next();
+        if (in.failed || freqs[s] > RANS_SCALE - start)
+            return false;
+        starts[s] = start;
+        start += freqs[s];
+    }
+    if (start != RANS_SCALE || codedSize < 4 || size_t(in.end - in.pos) < codedSize)
+        return false;
+    unsigned char symbols[RANS_SCALE];
+    for (unsigned int s = 0; s < 256; ++s)
+        std::memset(symbols + starts[s], static_cast<int>(s), freqs[s]);
+
+    const unsigned char *pos = in.pos;
+    const unsigned char *end = in.pos + codedSize;
+    uint32_t x = (uint32_t(pos[0]) << 24) | (uint32_t(pos[1]) << 16) | (uint32_t(pos[2]) << 8)
+            | uint32_t(pos[3]);
+    pos += 4;
+    for (uint32_t i = 0; i < rawSize; ++i) {
+        const uint32_t slot = x & (RANS_SCALE - 1);
+        const unsigned char s = symbols[slot];
+        raw[i] = s;
+        x = freqs[s] * (x >> RANS_PROB_BITS) + slot - starts[s];
+        while (x < RANS_LOWER) {
+            if (pos == end)
+                return false;
+            x = (x << 8) | *pos++;
+        }
+    }
+    // a valid stream ends exactly where the encoder started
+    if (pos != end || x != RANS_LOWER)
+        return false;
+    in.pos = end;
+    return true;
+}
+
+// =================
+// === PREDICTOR ===
+// =================
+
+// ends a list of outgoing edges
+const uint32_t NO_EDGE = ~0u;
+
+// Parallelogram predictor of one chunk. Encoder and decoder feed it the identical sequence of
+// triangles, so both sides always agree on the prediction.
+class ChunkPredictor
+{
+public:
+    ChunkPredictor(uint32_t firstVertex, const Vec3i *positions, const Vec3i &start,
+                   size_t vertexCount, size_t triangleCount)
+        : firstVertex(firstVertex), positions(positions), last(start),
+          firstEdge(vertexCount, NO_EDGE)
+    {
+        edges.reserve(3 * triangleCount);
+    }
+
+    // predicts the position of the new vertex at the given corner. only vertices of this chunk
+    // below decodedEnd are known.
+    Vec3i predict(const Vec3i &tri, int corner, uint32_t decodedEnd) const
+    {
+        const uint32_t a = tri[(corner + 1) % 3];
+        const uint32_t b = tri[(corner + 2) % 3];
+        const bool haveA = a >= firstVertex && a < decodedEnd;
+        const bool haveB = b >= firstVertex && b < decodedEnd;
+        if (haveA && haveB) {
+            // the triangle across edge a->b stores it as b->a. the newest one wins on
+            // non-manifold edges.
+            for (uint32_t e = firstEdge[b - firstVertex]; e != NO_EDGE; e = edges[e].next) {
+                if (edges[e].to == a)
+                    return position(a) + position(b) - position(edges[e].opposite);
+            }
+        }
+        if (haveA)
+            return position(a);
+        if (haveB)
+            return position(b);
+        return last;
+    }
+
+    // registers the directed edges of a completely decoded triangle
+    void addTriangle(const Vec3i &tri)
+    {
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t from = tri[k];
+            const uint32_t opp = tri[(k + 2) % 3];
+            // edges leaving older chunks are never looked up
+            if (from < firstVertex || opp < firstVertex)
+                continue;
+            uint32_t &head = firstEdge[from - firstVertex];
+            edges.push_back({ static_cast<uint32_t>(tri[(k + 1) % 3]), opp, head });
+            head = static_cast<uint32_t>(edges.size() - 1);
+        }
+    }
+
+    const Vec3i &position(uint32_t index) const { return positions[index - firstVertex]; }
+
+    uint32_t firstVertex;
+    const Vec3i *positions;
+    Vec3i last;
+
+private:
+    struct Edge
+    {
+        uint32_t to;
+        uint32_t opposite;
+        uint32_t next;
+    };
+
+    // outgoing edges per vertex of the chunk as linked lists in one pool, newest first. the
+    // vertices of recent triangles are close in numbering, so the lists stay in cache.
+    std::vector<uint32_t> firstEdge;
+    std::vector<Edge> edges;
+};
+
+// ===============
+// === ENCODER ===
+// ===============
+
+void encodeResidual(std::vector<unsigned char> &out, const Vec3i &actual, const Vec3i &predicted)
+{
+    for (unsigned int axis = 0; axis < 3; ++axis)
+        putVarint(out, zigzag(actual[axis] - predicted[axis]));
+}
+
+void encodeChunk(const ChunkInfo &chunk, const std::vector<Vec3i> &tris,
+                 const std::vector<Vec3i> &quantized, const Vec3i &start,
+                 std::vector<unsigned char> &out)
+{
+    // connectivity codes and position residuals have very different statistics, so each gets
+    // its own stream and frequency table
+    std::vector<unsigned char> connectivity, geometry;
+    connectivity.reserve(size_t(chunk.triangleCount) * 3);
+    geometry.reserve(size_t(chunk.vertexCount) * 6);
+    ChunkPredictor predictor(chunk.firstVertex, quantized.data() + chunk.firstVertex, start,
+                             chunk.vertexCount, chunk.triangleCount);
+    uint32_t nextIndex = chunk.firstVertex;
+    uint32_t nextPos = chunk.firstVertex;
+    const uint32_t lastTriangle = chunk.firstTriangle + chunk.triangleCount;
+    for (uint32_t t = chunk.firstTriangle; t < lastTriangle; ++t) {
+        const Vec3i &tri = tris[t];
+        // connectivity: distance to the next unused vertex, 0 introduces a new one
+        for (unsigned int k = 0; k < 3; ++k) {
+            const uint32_t index = tri[k];
+            putVarint(connectivity, nextIndex - index);
+            if (index == nextIndex)
+                ++nextIndex;
+        }
+        // geometry of the vertices introduced by this triangle
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t index = tri[k];
+            if (index != nextPos)
+                continue;
+            encodeResidual(geometry, quantized[index], predictor.predict(tri, k, nextPos));
+            predictor.last = quantized[index];
+            ++nextPos;
+        }
+        predictor.addTriangle(tri);
+    }
+    // vertices not referenced by any triangle
+    for (; nextPos < chunk.firstVertex + chunk.vertexCount; ++nextPos) {
+        encodeResidual(geometry, quantized[nextPos], predictor.last);
+        predictor.last = quantized[nextPos];
+    }
+    entropyEncode(connectivity, out);
+    entropyEncode(geometry, out);
+}
+
+// ===============
+// === DECODER ===
+// ===============
+
+bool decodeResidual(VarintReader &in, const Vec3i &predicted, int32_t maxQ, Vec3i &result)
+{
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        const int64_t value = int64_t(predicted[axis]) + unzigzag(in.next());
+        if (in.failed || value < 0 || value > maxQ)
+            return false;
+        result[axis] = static_cast<int32_t>(value);
+    }
+    return true;
+}
+
+bool decodeChunk(const ChunkInfo &chunk, const unsigned char *payload, int32_t maxQ,
+                 const Vec3f &bboxMin, const Vec3f &scale, std::vector<Vec3f> &vertices,
+                 std::vector<Vec3i> &triangles)
+{
+    VarintReader payloadReader { payload, payload + chunk.size };
+    std::vector<unsigned char> connectivityBytes, geometryBytes;
+    // a varint takes at most 5 bytes
+    if (!entropyDecode(payloadReader, size_t(chunk.triangleCount) * 15, connectivityBytes)
+        || !entropyDecode(payloadReader, size_t(chunk.vertexCount) * 15, geometryBytes)
+        || payloadReader.pos != payloadReader.end)
+        return false;
+    VarintReader in { connectivityBytes.data(),
+                      connectivityBytes.data() + connectivityBytes.size() };
+    VarintReader geometryIn { geometryBytes.data(), geometryBytes.data() + geometryBytes.size() };
+    std::vector<Vec3i> local(chunk.vertexCount);
+    ChunkPredictor predictor(chunk.firstVertex, local.data(), Vec3i(maxQ / 2),
+                             chunk.vertexCount, chunk.triangleCount);
+    const uint32_t vertexEnd = chunk.firstVertex + chunk.vertexCount;
+    uint32_t nextIndex = chunk.firstVertex;
+    uint32_t nextPos = chunk.firstVertex;
+    const uint32_t lastTriangle = chunk.firstTriangle + chunk.triangleCount;
+    for (uint32_t t = chunk.firstTriangle; t < lastTriangle; ++t) {
+        Vec3i tri;
+        for (unsigned int k = 0; k < 3; ++k) {
+            const uint32_t code = in.next();
+            if (in.failed || code > nextIndex)
+                return false;
+            if (code == 0) {
+                if (nextIndex >= vertexEnd)
+                    return false;
+                ++nextIndex;
+                tri[k] = static_cast<int>(nextIndex - 1);
+            } else {
+                tri[k] = static_cast<int>(nextIndex - code);
+            }
+        }
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t index = tri[k];
+            if (index != nextPos)
+                continue;
+            Vec3i &q = local[index - chunk.firstVertex];
+            if (!decodeResidual(geometryIn, predictor.predict(tri, k, nextPos), maxQ, q))
+                return false;
+            predictor.last = q;
+            ++nextPos;
+        }
+        triangles[t] = tri;
+        predictor.addTriangle(tri);
+    }
+    for (; nextPos < vertexEnd; ++nextPos) {
+        Vec3i &q = local[nextPos - chunk.firstVertex];
+        if (!decodeResidual(geometryIn, predictor.last, maxQ, q))
+            return false;
+        predictor.last = q;
+    }
+    if (in.pos != in.end || geometryIn.pos != geometryIn.end)
+        return false;
+
+    for (uint32_t i = 0; i < chunk.vertexCount; ++i) {
+        const Vec3i &q = local[i];
+        vertices[chunk.firstVertex + i] = Vec3f(bboxMin.x() + q.x() * scale.x(),
+                                                bboxMin.y() + q.y() * scale.y(),
+                                                bboxMin.z() + q.z() * scale.z());
+    }
+    return true;
+}
+
+} // namespace
+
+bool MeshCodec::encode(const std::vector<Vec3f> &vertices, const std::vector<Vec3i> &triangles,
+                       std::vector<unsigned char> &out, unsigned int quantizationBits,
+                       unsigned int chunkTriangles)
+{
+    if (quantizationBits < 1 || quantizationBits > 30 || vertices.size() > UINT32_MAX / 2
+        || triangles.size() > UINT32_MAX)
+        return false;
+    chunkTriangles = std::max(chunkTriangles, 1u);
+    const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+    const uint32_t triangleCount = static_cast<uint32_t>(triangles.size());
+    for (const auto &tri : triangles) {
+        for (unsigned int k = 0; k < 3; ++k) {
+            if (tri[k] < 0 || uint32_t(tri[k]) >= vertexCount)
+                return false;
+        }
+    }
+
+    // split triangles into chunks and renumber vertices in order of first use
+    const uint32_t chunkCount = std::max(1u, (triangleCount + chunkTriangles - 1) / chunkTriangles);
+    std::vector<ChunkInfo> chunks(chunkCount);
+    std::vector<int> newIndex(vertexCount, -1);
+    std::vector<uint32_t> oldIndex;
+    oldIndex.reserve(vertexCount);
+    for (uint32_t c = 0; c < chunkCount; ++c) {
+        ChunkInfo &chunk = chunks[c];
+        chunk.firstVertex = static_cast<uint32_t>(oldIndex.size());
+        chunk.firstTriangle = c * chunkTriangles;
+        chunk.triangleCount = std::min(chunkTriangles, triangleCount - chunk.firstTriangle);
+        for (uint32_t t = chunk.firstTriangle; t < chunk.firstTriangle + chunk.triangleCount; ++t) {
+            for (unsigned int k = 0; k < 3; ++k) {
+                int &mapped = newIndex[triangles[t][k]];
+                if (mapped < 0) {
+                    mapped = static_cast<int>(oldIndex.size());
+                    oldIndex.push_back(triangles[t][k]);
+                }
+            }
+        }
+        // unreferenced vertices go to the last chunk
+        if (c + 1 == chunkCount) {
+            for (uint32_t v = 0; v < vertexCount; ++v) {
+                if (newIndex[v] < 0) {
+                    newIndex[v] = static_cast<int>(oldIndex.size());
+                    oldIndex.push_back(v);
+                }
+            }
+        }
+        chunk.vertexCount = static_cast<uint32_t>(oldIndex.size()) - chunk.firstVertex;
+    }
+
+    // quantize positions to the bounding box
+    Vec3f bboxMin(FLT_MAX), bboxMax(-FLT_MAX);
+    for (const auto &v : vertices) {
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            bboxMin[axis] = std::min(bboxMin[axis], v[axis]);
+            bboxMax[axis] = std::max(bboxMax[axis], v[axis]);
+        }
+    }
+    if (vertices.empty())
+        bboxMin = bboxMax = Vec3f(0.f);
+    const int32_t maxQ = static_cast<int32_t>((1u << quantizationBits) - 1);
+    std::vector<Vec3i> quantized(vertexCount);
+    std::vector<Vec3i> tris(triangleCount);
+    parallelFor(0, vertexCount, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const Vec3f &v = vertices[oldIndex[i]];
+            for (unsigned int axis = 0; axis < 3; ++axis) {
+                const float extent = bboxMax[axis] - bboxMin[axis];
+                const float t = extent > 0.f ? (v[axis] - bboxMin[axis]) / extent : 0.f;
+                const long q = std::lround(t * maxQ);
+                quantized[i][axis] = static_cast<int32_t>(std::min<long>(std::max(q, 0L), maxQ));
+            }
+        }
+    });
+    parallelFor(0, triangleCount, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            tris[t] = Vec3i(newIndex[triangles[t].x()], newIndex[triangles[t].y()],
+                            newIndex[triangles[t].z()]);
+        }
+    });
+
+    std::vector<std::vector<unsigned char>> payloads(chunkCount);
+    parallelFor(
+            0, chunkCount,
+            [&](size_t first, size_t last) {
+                for (size_t c = first; c < last; ++c)
+                    encodeChunk(chunks[c], tris, quantized, Vec3i(maxQ / 2), payloads[c]);
+            },
+            1);
+
+    // write header, chunk table and payloads
+    uint64_t offset = 0;
+    for (uint32_t c = 0; c < chunkCount; ++c) {
+        chunks[c].offset = offset;
+        chunks[c].size = payloads[c].size();
+        offset += chunks[c].size;
+    }
+    out.clear();
+    out.reserve(HEADER_SIZE + chunkCount * CHUNK_ENTRY_SIZE + offset);
+    out.insert(out.end(), CMSH_MAGIC, CMSH_MAGIC + 4);
+    putU32(out, CMSH_VERSION);
+    putU32(out, vertexCount);
+    putU32(out, triangleCount);
+    putU32(out, chunkCount);
+    putU32(out, quantizationBits);
+    for (unsigned int axis = 0; axis < 3; ++axis)
+        putF32(out, bboxMin[axis]);
+    for (unsigned int axis = 0; axis < 3; ++axis)
+        putF32(out, bboxMax[axis]);
+    for (const auto &chunk : chunks) {
+        putU32(out, chunk.firstVertex);
+        putU32(out, chunk.vertexCount);
+        putU32(out, chunk.firstTriangle);
+        putU32(out, chunk.triangleCount);
+        putU64(out, chunk.offset);
+        putU64(out, chunk.size);
+    }
+    for (const auto &payload : payloads)
+        out.insert(out.end(), payload.begin(), payload.end());
+    return true;
+}
+
+bool MeshCodec::decode(const unsigned char *data, size_t size, std::vector<Vec3f> &vertices,
+                       std::vector<Vec3i> &triangles)
+{
+    vertices.clear();
+    triangles.clear();
+    if (size < HEADER_SIZE || std::memcmp(data, CMSH_MAGIC, 4) != 0)
+        return false;
+    if (getU32(data + 4) != CMSH_VERSION)
+        return false;
+
+    const uint32_t vertexCount = getU32(data + 8);
+    const uint32_t triangleCount = getU32(data + 12);
+    const uint32_t chunkCount = getU32(data + 16);
+    const uint32_t quantizationBits = getU32(data + 20);
+    Vec3f bboxMin, bboxMax;
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        bboxMin[axis] = getF32(data + 24 + 4 * axis);
+        bboxMax[axis] = getF32(data + 36 + 4 * axis);
+    }
+    if (quantizationBits < 1 || quantizationBits > 30 || chunkCount == 0
+        || (size - HEADER_SIZE) / CHUNK_ENTRY_SIZE < chunkCount)
+        return false;
+
+    // read and validate the chunk table
+    const unsigned char *table = data + HEADER_SIZE;
+    const unsigned char *payloads = table + size_t(chunkCount) * CHUNK_ENTRY_SIZE;
+    const uint64_t payloadSize = static_cast<uint64_t>(data + size - payloads);
+    std::vector<ChunkInfo> chunks(chunkCount);
+    uint64_t vertexSum = 0, triangleSum = 0, payloadSum = 0;
+    for (uint32_t c = 0; c < chunkCount; ++c) {
+        const unsigned char *entry = table + size_t(c) * CHUNK_ENTRY_SIZE;
+        ChunkInfo &chunk = chunks[c];
+        chunk.firstVertex = getU32(entry);
+        chunk.vertexCount = getU32(entry + 4);
+        chunk.firstTriangle = getU32(entry + 8);
+        chunk.triangleCount = getU32(entry + 12);
+        chunk.offset = getU64(entry + 16);
+        chunk.size = getU64(entry + 24);
+        // payloads are stored back to back in chunk order
+        if (chunk.firstVertex != vertexSum || chunk.firstTriangle != triangleSum
+            || chunk.offset != payloadSum || chunk.size > payloadSize - chunk.offset)
+            return false;
+        vertexSum += chunk.vertexCount;
+        triangleSum += chunk.triangleCount;
+        payloadSum += chunk.size;
+    }
+    if (vertexSum != vertexCount || triangleSum != triangleCount || payloadSum != payloadSize)
+        return false;
+
+    const int32_t maxQ = static_cast<int32_t>((1u << quantizationBits) - 1);
+    const Vec3f scale((bboxMax.x() - bboxMin.x()) / maxQ, (bboxMax.y() - bboxMin.y()) / maxQ,
+                      (bboxMax.z() - bboxMin.z()) / maxQ);
+    vertices.resize(vertexCount);
+    triangles.resize(triangleCount);
+    std::atomic<bool> ok(true);
+    parallelFor(
+            0, chunkCount,
+            [&](size_t first, size_t last) {
+                for (size_t c = first; c < last && ok; ++c) {
+                    if (!decodeChunk(chunks[c], payloads + chunks[c].offset, maxQ, bboxMin,
+                                     scale, vertices, triangles))
+                        ok = false;
+                }
+            },
+            1);
+    if (!ok) {
+        vertices.clear();
+        triangles.clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,46 @@
+// ========================================================================= //
+// Content: Compressed mesh container (CMSH) encoder and decoder             //
+// ========================================================================= //
+
+#ifndef MESHCODEC_H
+#define MESHCODEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "vec3.h"
+
+// CMSH layout (all values little endian):
+//   header      "CMSH", version, vertex count, triangle count, chunk count, quantization bits,
+//               bounding box min/max (6 floats)
+//   chunk table per chunk: first vertex, vertex count, first triangle, triangle count,
+//               payload offset and payload size (relative to the end of the table)
+//   payloads    per chunk a connectivity and a geometry stream of varints, each entropy coded
+//               with an order-0 rANS coder (stored as is where that does not pay off)
+//
+// Vertices are renumbered in order of first use, so every chunk owns a contiguous vertex range
+// and a corner either introduces the next vertex (code 0) or references an older one by its
+// distance to the next vertex. Positions are quantized to the bounding box and stored as zigzag
+// residuals against a parallelogram prediction across the neighbouring triangle. Predictions
+// only use vertices of the own chunk, hence all chunks decode independently and in parallel.
+class MeshCodec
+{
+public:
+    static const unsigned int DEFAULT_QUANTIZATION_BITS = 16;
+    static const unsigned int DEFAULT_CHUNK_TRIANGLES = 1 << 16;
+
+    // encodes the mesh into out. returns false if the mesh can not be represented (invalid
+    // indices or quantizationBits outside [1, 30]).
+    static bool encode(const std::vector<Vec3f> &vertices, const std::vector<Vec3i> &triangles,
+                       std::vector<unsigned char> &out,
+                       unsigned int quantizationBits = DEFAULT_QUANTIZATION_BITS,
+                       unsigned int chunkTriangles = DEFAULT_CHUNK_TRIANGLES);
+
+    // decodes a CMSH buffer straight into vertices and triangles. returns false on corrupt data,
+    // in which case both vectors are left empty.
+    static bool decode(const unsigned char *data, size_t size, std::vector<Vec3f> &vertices,
+                       std::vector<Vec3i> &triangles);
+};
+
+#endif // MESHCODEC_H
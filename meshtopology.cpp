@@ -0,0 +1,150 @@
+// ========================================================================= //
+// Content: Vertex adjacency of triangle meshes in compressed row storage    //
+// ========================================================================= //
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "meshtopology.h"
+#include "parallel.h"
+
+namespace {
+
+// cotangent of the angle at c in the triangle (c, p, q)
+float cotangent(const Vec3f &c, const Vec3f &p, const Vec3f &q)
+{
+    const Vec3f u = p - c, v = q - c;
+    const float sine = cross(u, v).length();
+    return (u * v) / std::max(sine, 1e-12f);
+}
+
+// collects the one-ring of vertex v from its incident triangles. sorted unique neighbors go to
+// ring, their accumulated cotangent weights to ringWeights (if weights is true). returns true
+// if v lies on a boundary edge.
+bool collectRing(uint32_t v, const uint32_t *incidentBegin, const uint32_t *incidentEnd,
+                 const vector<Vec3f> &vertices, const vector<Vec3i> &triangles, bool weights,
+                 vector<uint32_t> &candidates, vector<uint32_t> &ring, vector<float> &ringWeights)
+{
+    candidates.clear();
+    for (const uint32_t *t = incidentBegin; t != incidentEnd; ++t) {
+        const Vec3i &tri = triangles[*t];
+        const unsigned int k = tri[0] == int(v) ? 0 : (tri[1] == int(v) ? 1 : 2);
+        const uint32_t a = tri[(k + 1) % 3], b = tri[(k + 2) % 3];
+        if (a != v)
+            candidates.push_back(a);
+        if (b != v)
+            candidates.push_back(b);
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    // an edge seen from only one triangle is a boundary edge
+    bool boundary = false;
+    ring.clear();
+    for (size_t i = 0; i < candidates.size();) {
+        size_t j = i + 1;
+        while (j < candidates.size() && candidates[j] == candidates[i])
+            ++j;
+        boundary |= (j - i) == 1;
+        ring.push_back(candidates[i]);
+        i = j;
+    }
+
+    if (weights) {
+        ringWeights.assign(ring.size(), 0.f);
+        const auto add = [&](uint32_t neighbor, float w) {
+            const auto it = std::lower_bound(ring.begin(), ring.end(), neighbor);
+            if (it != ring.end() && *it == neighbor)
+                ringWeights[it - ring.begin()] += 0.5f * w;
+        };
+        for (const uint32_t *t = incidentBegin; t != incidentEnd; ++t) {
+            const Vec3i &tri = triangles[*t];
+            const unsigned int k = tri[0] == int(v) ? 0 : (tri[1] == int(v) ? 1 : 2);
+            const uint32_t a = tri[(k + 1) % 3], b = tri[(k + 2) % 3];
+            // the edge (v, a) is opposite to b and vice versa
+            add(a, cotangent(vertices[b], vertices[v], vertices[a]));
+            add(b, cotangent(vertices[a], vertices[v], vertices[b]));
+        }
+        for (auto &w : ringWeights)
+            w = std::max(w, 1e-4f);
+    }
+    return boundary;
+}
+
+} // namespace
+
+VertexNeighbors VertexNeighbors::build(const vector<Vec3f> &vertices,
+                                       const vector<Vec3i> &triangles, bool cotangentWeights)
+{
+    const size_t vertexCount = vertices.size();
+    const size_t triangleCount = triangles.size();
+    VertexNeighbors result;
+    result.offsets.assign(vertexCount + 1, 0);
+    result.boundary.assign(vertexCount, 0);
+
+    // vertex -> triangle incidence, filled with atomic counters
+    vector<std::atomic<uint32_t>> cursor(vertexCount);
+    parallelFor(0, vertexCount, [&](size_t first, size_t last) {
+        for (size_t v = first; v < last; ++v)
+            cursor[v].store(0, std::memory_order_relaxed);
+    });
+    parallelFor(0, triangleCount, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            for (unsigned int k = 0; k < 3; ++k)
+                cursor[triangles[t][k]].fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    vector<uint32_t> incidenceOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        incidenceOffsets[v + 1] = incidenceOffsets[v] + cursor[v].load(std::memory_order_relaxed);
+        cursor[v].store(incidenceOffsets[v], std::memory_order_relaxed);
+    }
+    vector<uint32_t> incidence(incidenceOffsets.back());
+    parallelFor(0, triangleCount, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            for (unsigned int k = 0; k < 3; ++k) {
+                // a triangle with a repeated index is listed once per vertex
+                const int v = triangles[t][k];
+                if ((k > 0 && triangles[t][0] == v) || (k > 1 && triangles[t][1] == v))
+                    continue;
+                incidence[cursor[v].fetch_add(1, std::memory_order_relaxed)] =
+                        static_cast<uint32_t>(t);
+            }
+        }
+    });
+
+    // two passes over the vertices: count the ring sizes, then fill the rings
+    const auto incidentBegin = [&](size_t v) { return incidence.data() + incidenceOffsets[v]; };
+    const auto incidentEnd = [&](size_t v) {
+        return incidence.data() + cursor[v].load(std::memory_order_relaxed);
+    };
+    parallelFor(0, vertexCount, [&](size_t first, size_t last) {
+        vector<uint32_t> candidates, ring;
+        vector<float> ringWeights;
+        for (size_t v = first; v < last; ++v) {
+            result.boundary[v] = collectRing(static_cast<uint32_t>(v), incidentBegin(v),
+                                             incidentEnd(v), vertices, triangles, false,
+                                             candidates, ring, ringWeights);
+            result.offsets[v + 1] = static_cast<uint32_t>(ring.size());
+        }
+    });
+    for (size_t v = 0; v < vertexCount; ++v)
+        result.offsets[v + 1] += result.offsets[v];
+
+    result.neighbors.resize(result.offsets.back());
+    if (cotangentWeights)
+        result.weights.resize(result.offsets.back());
+    parallelFor(0, vertexCount, [&](size_t first, size_t last) {
+        vector<uint32_t> candidates, ring;
+        vector<float> ringWeights;
+        for (size_t v = first; v < last; ++v) {
+            collectRing(static_cast<uint32_t>(v), incidentBegin(v), incidentEnd(v), vertices,
+                        triangles, cotangentWeights, candidates, ring, ringWeights);
+            std::copy(ring.begin(), ring.end(), result.neighbors.begin() + result.offsets[v]);
+            if (cotangentWeights)
+                std::copy(ringWeights.begin(), ringWeights.end(),
+                          result.weights.begin() + result.offsets[v]);
+        }
+    });
+    return result;
+}
@@ -0,0 +1,36 @@
+// ========================================================================= //
+// Content: Vertex adjacency of triangle meshes in compressed row storage    //
+// ========================================================================= //
+
+#ifndef MESHTOPOLOGY_H
+#define MESHTOPOLOGY_H
+
+#include <cstdint>
+#include <vector>
+
+#include "vec3.h"
+
+using namespace std;
+
+// One-ring neighbors of every vertex in CSR layout: the neighbors of vertex v are
+// neighbors[offsets[v]] ... neighbors[offsets[v + 1] - 1], sorted by index.
+struct VertexNeighbors
+{
+    vector<uint32_t> offsets;
+    vector<uint32_t> neighbors;
+    // cotangent weight per neighbor, (cot a + cot b) / 2 of the angles opposite the edge.
+    // only filled if requested, clamped to a small positive value.
+    vector<float> weights;
+    // 1 for vertices on an edge with only one adjacent triangle
+    vector<unsigned char> boundary;
+
+    uint32_t begin(size_t v) const { return offsets[v]; }
+    uint32_t end(size_t v) const { return offsets[v + 1]; }
+    uint32_t valence(size_t v) const { return offsets[v + 1] - offsets[v]; }
+
+    // builds the adjacency in parallel. the triangle indices have to be valid.
+    static VertexNeighbors build(const vector<Vec3f> &vertices, const vector<Vec3i> &triangles,
+                                 bool cotangentWeights = false);
+};
+
+#endif // MESHTOPOLOGY_H
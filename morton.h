@@ -0,0 +1,41 @@
+// ========================================================================= //
+// Content: Morton codes (Z-order curve) of 3D points                        //
+// ========================================================================= //
+
+#ifndef MORTON_H
+#define MORTON_H
+
+#include <algorithm>
+#include <cstdint>
+
+#include "vec3.h"
+
+// bits per axis, three axes fit into 64 bit
+const unsigned int MORTON_BITS = 21;
+
+// spreads the lower 21 bits of v so that two zero bits lie between each pair of bits
+inline uint64_t spreadBits(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+// interleaved code of p in a cube starting at origin. scale maps the cube edge to
+// 2^MORTON_BITS - 1, points outside the cube are clamped.
+inline uint64_t mortonCode(const Vec3f &p, const Vec3f &origin, float scale)
+{
+    const float maxCoordinate = static_cast<float>((1u << MORTON_BITS) - 1);
+    uint64_t code = 0;
+    for (unsigned int axis = 0; axis < 3; ++axis) {
+        const float c = std::min(std::max((p[axis] - origin[axis]) * scale, 0.f), maxCoordinate);
+        code |= spreadBits(static_cast<uint64_t>(c)) << axis;
+    }
+    return code;
+}
+
+#endif // MORTON_H
@@ -0,0 +1,366 @@
+// ========================================================================= //
+// Content: Hierarchical-Z occlusion culling with a CPU depth rasterizer     //
+// ========================================================================= //
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+#if defined(__SSE__) || defined(_M_X64)
+#    include <xmmintrin.h>
+#    define CULLER_USE_SSE
+#endif
+
+#include "occlusionculler.h"
+#include "parallel.h"
+
+namespace {
+
+// rows rasterized by one task
+const int BAND_ROWS = 8;
+// clusters covering fewer depth buffer pixels are not worth rasterizing as occluders
+const float MIN_OCCLUDER_PIXELS = 64.f;
+
+// triangle in depth buffer pixels: edge functions a * x + b * y + c and the depth plane
+// zA * x + zB * y + zC, evaluated at pixel centers. to keep the culling conservative, the
+// constants are shifted by half a pixel: all edge functions are >= 0 only if the whole pixel is
+// covered, and the plane gives the farthest depth the triangle reaches within the pixel.
+struct ScreenTriangle
+{
+    float a[3], b[3], c[3];
+    float zA, zB, zC;
+    int minX, maxX, minY, maxY;
+};
+
+// screen rectangle (in pixels) and nearest depth of a box. returns false if the box is outside
+// the frustum, sets crossesNear if a corner lies behind the eye.
+bool projectBox(const Mat4f &mvp, const Vec3f &bboxMin, const Vec3f &bboxMax, int width,
+                int height, float rect[4], float &minZ, bool &crossesNear)
+{
+    int outside[6] = { 0, 0, 0, 0, 0, 0 };
+    rect[0] = rect[1] = FLT_MAX;
+    rect[2] = rect[3] = -FLT_MAX;
+    minZ = FLT_MAX;
+    crossesNear = false;
+    for (unsigned int corner = 0; corner < 8; ++corner) {
+        const Vec3f p((corner & 1) ? bboxMax.x() : bboxMin.x(),
+                      (corner & 2) ? bboxMax.y() : bboxMin.y(),
+                      (corner & 4) ? bboxMax.z() : bboxMin.z());
+        float clip[4];
+        mvp.transformPoint(p, clip);
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            outside[2 * axis] += clip[axis] < -clip[3];
+            outside[2 * axis + 1] += clip[axis] > clip[3];
+        }
+        if (clip[3] <= EPS) {
+            crossesNear = true;
+            continue;
+        }
+        const float x = (clip[0] / clip[3] * 0.5f + 0.5f) * width;
+        const float y = (clip[1] / clip[3] * 0.5f + 0.5f) * height;
+        rect[0] = std::min(rect[0], x);
+        rect[1] = std::min(rect[1], y);
+        rect[2] = std::max(rect[2], x);
+        rect[3] = std::max(rect[3], y);
+        minZ = std::min(minZ, clip[2] / clip[3]);
+    }
+    for (int plane : outside) {
+        if (plane == 8)
+            return false;
+    }
+    return true;
+}
+
+// sets up t from three clip space vertices. returns false for triangles that can not be
+// rasterized: reaching behind the eye, outside the buffer or without area.
+bool setupTriangle(const float clip[3][4], int width, int height, ScreenTriangle &t)
+{
+    float x[3], y[3], z[3];
+    for (unsigned int k = 0; k < 3; ++k) {
+        if (clip[k][3] <= EPS)
+            return false;
+        const float invW = 1.f / clip[k][3];
+        x[k] = (clip[k][0] * invW * 0.5f + 0.5f) * width;
+        y[k] = (clip[k][1] * invW * 0.5f + 0.5f) * height;
+        z[k] = clip[k][2] * invW;
+    }
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (std::fabs(area) < 1e-8f)
+        return false;
+    // both windings occlude, bring the triangle into counter clockwise order
+    if (area < 0.f) {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+    }
+
+    const float minX = std::min(x[0], std::min(x[1], x[2]));
+    const float maxX = std::max(x[0], std::max(x[1], x[2]));
+    const float minY = std::min(y[0], std::min(y[1], y[2]));
+    const float maxY = std::max(y[0], std::max(y[1], y[2]));
+    if (maxX < 0.f || maxY < 0.f || minX >= width || minY >= height)
+        return false;
+    t.minX = std::max(0, static_cast<int>(std::floor(minX)));
+    t.maxX = std::min(width - 1, static_cast<int>(std::ceil(maxX)));
+    t.minY = std::max(0, static_cast<int>(std::floor(minY)));
+    t.maxY = std::min(height - 1, static_cast<int>(std::ceil(maxY)));
+
+    // edge k runs from vertex k to vertex k + 1, the opposite vertex k + 2 weights its function
+    float zA = 0.f, zB = 0.f, zC = 0.f;
+    for (unsigned int k = 0; k < 3; ++k) {
+        const unsigned int k1 = (k + 1) % 3, k2 = (k + 2) % 3;
+        t.a[k] = y[k] - y[k1];
+        t.b[k] = x[k1] - x[k];
+        t.c[k] = x[k] * y[k1] - y[k] * x[k1];
+        zA += t.a[k] * z[k2];
+        zB += t.b[k] * z[k2];
+        zC += t.c[k] * z[k2];
+    }
+    t.zA = zA / area;
+    t.zB = zB / area;
+    t.zC = zC / area;
+    // a linear function changes by at most (|a| + |b|) / 2 between the center and a corner
+    for (unsigned int k = 0; k < 3; ++k)
+        t.c[k] -= 0.5f * (std::fabs(t.a[k]) + std::fabs(t.b[k]));
+    t.zC += 0.5f * (std::fabs(t.zA) + std::fabs(t.zB));
+    return true;
+}
+
+// keeps the nearest depth of t in the rows [rowBegin, rowEnd)
+void rasterizeTriangle(const ScreenTriangle &t, float *depth, int width, int rowBegin, int rowEnd)
+{
+    const int yBegin = std::max(t.minY, rowBegin);
+    const int yEnd = std::min(t.maxY + 1, rowEnd);
+    // rows are processed in aligned groups of four pixels, width is a multiple of 4
+    const int xBegin = t.minX & ~3;
+#ifdef CULLER_USE_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 a0 = _mm_set1_ps(t.a[0]), a1 = _mm_set1_ps(t.a[1]), a2 = _mm_set1_ps(t.a[2]);
+    const __m128 zA = _mm_set1_ps(t.zA);
+    const __m128 a0Step = _mm_set1_ps(4.f * t.a[0]), a1Step = _mm_set1_ps(4.f * t.a[1]),
+                 a2Step = _mm_set1_ps(4.f * t.a[2]), zStep = _mm_set1_ps(4.f * t.zA);
+    const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(xBegin)), offsets);
+    for (int y = yBegin; y < yEnd; ++y) {
+        const float py = y + 0.5f;
+        __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), _mm_set1_ps(t.b[0] * py + t.c[0]));
+        __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), _mm_set1_ps(t.b[1] * py + t.c[1]));
+        __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), _mm_set1_ps(t.b[2] * py + t.c[2]));
+        __m128 z = _mm_add_ps(_mm_mul_ps(zA, px), _mm_set1_ps(t.zB * py + t.zC));
+        float *row = depth + static_cast<size_t>(y) * width;
+        for (int x = xBegin; x <= t.maxX; x += 4) {
+            const __m128 inside = _mm_and_ps(
+                    _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)),
+                    _mm_cmpge_ps(e2, zero));
+            if (_mm_movemask_ps(inside)) {
+                const __m128 old = _mm_loadu_ps(row + x);
+                const __m128 nearest = _mm_min_ps(old, z);
+                _mm_storeu_ps(row + x,
+                              _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, old)));
+            }
+            e0 = _mm_add_ps(e0, a0Step);
+            e1 = _mm_add_ps(e1, a1Step);
+            e2 = _mm_add_ps(e2, a2Step);
+            z = _mm_add_ps(z, zStep);
+        }
+    }
+#else
+    for (int y = yBegin; y < yEnd; ++y) {
+        const float py = y + 0.5f;
+        float *row = depth + static_cast<size_t>(y) * width;
+        for (int x = xBegin; x < std::min(width, (t.maxX | 3) + 1); ++x) {
+            const float px = x + 0.5f;
+            if (t.a[0] * px + t.b[0] * py + t.c[0] >= 0.f
+                && t.a[1] * px + t.b[1] * py + t.c[1] >= 0.f
+                && t.a[2] * px + t.b[2] * py + t.c[2] >= 0.f)
+                row[x] = std::min(row[x], t.zA * px + t.zB * py + t.zC);
+        }
+    }
+#endif
+}
+
+} // namespace
+
+void OcclusionCuller::setResolution(int width)
+{
+    requestedWidth = std::max(4, (width + 3) & ~3);
+}
+
+void OcclusionCuller::render(const TriangleMesh &mesh, const Mat4f &modelViewProjection,
+                             int viewportWidth, int viewportHeight)
+{
+    mvp = modelViewProjection;
+    rasterizedTriangles = 0;
+    const int width = requestedWidth;
+    const int height = std::max(
+            1, static_cast<int>(std::lround(width * double(viewportHeight)
+                                            / std::max(viewportWidth, 1))));
+    pyramid.resize(1);
+    Level &buffer = pyramid[0];
+    buffer.width = width;
+    buffer.height = height;
+    buffer.depth.assign(static_cast<size_t>(width) * height, 1.f);
+
+    // occluders: the clusters with the largest projected bounds, up to the triangle budget
+    const vector<MeshCluster> &clusters = mesh.getClusters();
+    vector<float> coverage(clusters.size(), 0.f);
+    parallelFor(
+            0, clusters.size(),
+            [&](size_t first, size_t last) {
+                for (size_t c = first; c < last; ++c) {
+                    float rect[4], minZ;
+                    bool crossesNear;
+                    if (!projectBox(mvp, clusters[c].bboxMin, clusters[c].bboxMax, width,
+                                    height, rect, minZ, crossesNear)
+                        || crossesNear)
+                        continue;
+                    const float w = std::min(rect[2], float(width)) - std::max(rect[0], 0.f);
+                    const float h = std::min(rect[3], float(height)) - std::max(rect[1], 0.f);
+                    if (w > 0.f && h > 0.f)
+                        coverage[c] = w * h;
+                }
+            },
+            64);
+    vector<uint32_t> order(clusters.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(),
+              [&](uint32_t a, uint32_t b) { return coverage[a] > coverage[b]; });
+    vector<uint32_t> occluders;
+    size_t triangleCount = 0;
+    for (uint32_t c : order) {
+        if (coverage[c] < MIN_OCCLUDER_PIXELS || triangleCount + clusters[c].count > occluderBudget)
+            break;
+        occluders.push_back(c);
+        triangleCount += clusters[c].count;
+    }
+
+    // project the occluder triangles in parallel
+    const vector<Vec3f> &vertices = mesh.getPoints();
+    const auto &triangles = mesh.getClusterTriangles();
+    vector<size_t> offsets(occluders.size() + 1, 0);
+    for (size_t i = 0; i < occluders.size(); ++i)
+        offsets[i + 1] = offsets[i] + clusters[occluders[i]].count;
+    vector<ScreenTriangle> screenTriangles(triangleCount);
+    vector<unsigned char> valid(triangleCount, 0);
+    parallelFor(
+            0, occluders.size(),
+            [&](size_t first, size_t last) {
+                for (size_t i = first; i < last; ++i) {
+                    const MeshCluster &cluster = clusters[occluders[i]];
+                    for (uint32_t t = 0; t < cluster.count; ++t) {
+                        const Vec3i &tri = triangles[cluster.first + t];
+                        float clip[3][4];
+                        for (unsigned int k = 0; k < 3; ++k)
+                            mvp.transformPoint(vertices[tri[k]], clip[k]);
+                        valid[offsets[i] + t] = setupTriangle(clip, width, height,
+                                                              screenTriangles[offsets[i] + t]);
+                    }
+                }
+            },
+            1);
+    size_t kept = 0;
+    for (size_t i = 0; i < triangleCount; ++i) {
+        if (valid[i])
+            screenTriangles[kept++] = screenTriangles[i];
+    }
+    screenTriangles.resize(kept);
+    rasterizedTriangles = kept;
+
+    // every task owns a band of rows, so no two threads write the same pixel
+    const int bands = (height + BAND_ROWS - 1) / BAND_ROWS;
+    float *depth = buffer.depth.data();
+    parallelFor(
+            0, bands,
+            [&](size_t first, size_t last) {
+                const int rowBegin = static_cast<int>(first) * BAND_ROWS;
+                const int rowEnd = std::min(height, static_cast<int>(last) * BAND_ROWS);
+                for (const ScreenTriangle &t : screenTriangles) {
+                    if (t.maxY >= rowBegin && t.minY < rowEnd)
+                        rasterizeTriangle(t, depth, width, rowBegin, rowEnd);
+                }
+            },
+            1);
+
+    buildPyramid();
+}
+
+void OcclusionCuller::buildPyramid()
+{
+    // every level keeps the farthest depth of the (up to) 2x2 texels below it
+    while (pyramid.back().width > 1 || pyramid.back().height > 1) {
+        Level next;
+        const Level &previous = pyramid.back();
+        next.width = (previous.width + 1) / 2;
+        next.height = (previous.height + 1) / 2;
+        next.depth.resize(static_cast<size_t>(next.width) * next.height);
+        parallelFor(
+                0, next.height,
+                [&](size_t first, size_t last) {
+                    for (size_t y = first; y < last; ++y) {
+                        const size_t y0 = 2 * y;
+                        const size_t y1 = std::min<size_t>(y0 + 1, previous.height - 1);
+                        const float *row0 = previous.depth.data() + y0 * previous.width;
+                        const float *row1 = previous.depth.data() + y1 * previous.width;
+                        for (size_t x = 0; x < size_t(next.width); ++x) {
+                            const size_t x0 = 2 * x;
+                            const size_t x1 = std::min<size_t>(x0 + 1, previous.width - 1);
+                            next.depth[y * next.width + x] =
+                                    std::max(std::max(row0[x0], row0[x1]),
+                                             std::max(row1[x0], row1[x1]));
+                        }
+                    }
+                },
+                64);
+        pyramid.push_back(std::move(next));
+    }
+}
+
+bool OcclusionCuller::isVisible(const Vec3f &bboxMin, const Vec3f &bboxMax) const
+{
+    if (pyramid.empty())
+        return true;
+    const int width = pyramid[0].width, height = pyramid[0].height;
+    float rect[4], minZ;
+    bool crossesNear;
+    if (!projectBox(mvp, bboxMin, bboxMax, width, height, rect, minZ, crossesNear))
+        return false;
+    if (crossesNear)
+        return true;
+
+    // pixels touched by the projected box
+    const int x0 = std::max(0, static_cast<int>(std::floor(rect[0])));
+    const int y0 = std::max(0, static_cast<int>(std::floor(rect[1])));
+    const int x1 = std::min(width - 1, static_cast<int>(std::floor(rect[2])));
+    const int y1 = std::min(height - 1, static_cast<int>(std::floor(rect[3])));
+    if (x0 > x1 || y0 > y1)
+        return false;
+
+    // the finest level on which the rectangle covers at most 2x2 texels
+    unsigned int level = 0;
+    while (level + 1 < pyramid.size() && ((x1 >> level) - (x0 >> level) > 1
+                                          || (y1 >> level) - (y0 >> level) > 1))
+        ++level;
+    const Level &l = pyramid[level];
+    float maxDepth = -FLT_MAX;
+    for (int y = y0 >> level; y <= (y1 >> level); ++y) {
+        for (int x = x0 >> level; x <= (x1 >> level); ++x)
+            maxDepth = std::max(maxDepth, l.depth[static_cast<size_t>(y) * l.width + x]);
+    }
+    return minZ <= maxDepth;
+}
+
+size_t OcclusionCuller::cull(const TriangleMesh &mesh, vector<unsigned char> &visible) const
+{
+    const vector<MeshCluster> &clusters = mesh.getClusters();
+    visible.resize(clusters.size());
+    parallelFor(
+            0, clusters.size(),
+            [&](size_t first, size_t last) {
+                for (size_t c = first; c < last; ++c)
+                    visible[c] = isVisible(clusters[c].bboxMin, clusters[c].bboxMax);
+            },
+            64);
+    return static_cast<size_t>(std::count(visible.begin(), visible.end(), 1));
+}
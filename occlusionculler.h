@@ -0,0 +1,62 @@
+// ========================================================================= //
+// Content: Hierarchical-Z occlusion culling with a CPU depth rasterizer     //
+// ========================================================================= //
+
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <vector>
+
+#include "matrix.h"
+#include "trianglemesh.h"
+#include "vec3.h"
+
+using namespace std;
+
+// Hierarchical-Z occlusion culling on the CPU: the clusters of a mesh covering the largest
+// screen area are rasterized as occluders into a low resolution depth buffer (4 pixels per SSE
+// step, rows split over all cores). only fully covered pixels are written, with the farthest
+// depth of the triangle inside them, so the buffer never occludes more than the mesh does. a
+// pyramid of the farthest depth per 2x2 block then rejects clusters whose bounding box lies
+// completely behind the occluders.
+class OcclusionCuller
+{
+public:
+    // width of the depth buffer in pixels, rounded up to a multiple of 4. the height follows
+    // the aspect ratio of the viewport.
+    void setResolution(int width);
+    // at most this many triangles are rasterized per frame
+    void setOccluderBudget(size_t triangles) { occluderBudget = triangles; }
+
+    // rasterizes the occluders of mesh seen through modelViewProjection and builds the pyramid
+    void render(const TriangleMesh &mesh, const Mat4f &modelViewProjection, int viewportWidth,
+                int viewportHeight);
+
+    // false if the box lies outside the view frustum or behind the occluders of render()
+    bool isVisible(const Vec3f &bboxMin, const Vec3f &bboxMax) const;
+
+    // tests all clusters of mesh in parallel and sets visible[i] to 1 for the visible ones.
+    // returns the number of visible clusters.
+    size_t cull(const TriangleMesh &mesh, vector<unsigned char> &visible) const;
+
+    size_t occluderTriangles() const { return rasterizedTriangles; }
+
+private:
+    struct Level
+    {
+        int width = 0;
+        int height = 0;
+        vector<float> depth;
+    };
+
+    Mat4f mvp;
+    int requestedWidth = 256;
+    size_t occluderBudget = 1 << 15;
+    size_t rasterizedTriangles = 0;
+    // level 0 is the depth buffer (normalized device z, cleared to the far plane)
+    vector<Level> pyramid;
+
+    void buildPyramid();
+};
+
+#endif // OCCLUSIONCULLER_H
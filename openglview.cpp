@@ -9,29 +9,151 @@
 // Content: Widget for showing OpenGL scene                                  //
 // ========================================================================= //
 
+#include <algorithm>
 #include <cmath>
 
 #include <QtDebug>
-#include <QMatrix4x4>
+#include <QFileInfo>
+#include <QtConcurrent>
 #include <QOpenGLVersionFunctionsFactory>
 
 #include "openglview.h"
 
+namespace {
+
+// ambient occlusion bake: rays per vertex cast in one pass and in total
+const unsigned int AO_RAYS_PER_PASS = 32;
+const unsigned int AO_RAYS_TOTAL = 256;
+
+} // namespace
+
 OpenGLView::OpenGLView(QWidget *parent) : QOpenGLWidget(parent)
 {
     setDefaults();
 
     // Load ballon mesh
-    triMesh.loadOBJ("../Modelle/ballon.obj");
-    // triMesh.loadLSA("../Modelle/delphin.lsa");
+    loadMesh("../Modelle/ballon.obj");
+    // loadMesh("../Modelle/delphin.lsa");
 
-    // Load the sphere of the light
+    // Load the sphere of the light, one Loop level rounds off its coarse facets
     sphereMesh.loadOBJ("../Modelle/sphere.obj");
+    sphereMesh.subdivideLoop(1);
 
     connect(&fpsCounterTimer, &QTimer::timeout, this, &OpenGLView::refreshFpsCounter);
     fpsCounterTimer.setInterval(1000);
     fpsCounterTimer.setSingleShot(false);
     fpsCounterTimer.start();
+
+    // editors often write a file in several steps, so wait until it settled before reloading
+    meshReloadDelay.setInterval(100);
+    meshReloadDelay.setSingleShot(true);
+    connect(&meshFileWatcher, &QFileSystemWatcher::fileChanged, &meshReloadDelay,
+            qOverload<>(&QTimer::start));
+    connect(&meshReloadDelay, &QTimer::timeout, this, &OpenGLView::startMeshReload);
+    connect(&meshReloadWatcher, &QFutureWatcher<MeshReload>::finished, this,
+            &OpenGLView::finishMeshReload);
+    connect(&aoBakeWatcher, &QFutureWatcher<size_t>::finished, this,
+            &OpenGLView::finishAmbientOcclusionPass);
+}
+
+OpenGLView::~OpenGLView()
+{
+    meshReloadWatcher.waitForFinished();
+    if (aoBake)
+        aoBake->cancel();
+    aoBakeWatcher.waitForFinished();
+    makeCurrent();
+    triMesh.releaseBuffers(f);
+    sphereMesh.releaseBuffers(f);
+    pointCloud.releaseBuffers(f);
+    sceneLines.releaseBuffers(f);
+    doneCurrent();
+}
+
+void OpenGLView::loadMeshFile(TriangleMesh &mesh, const QString &fileName, bool triangulateScans)
+{
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+    const QByteArray path = fileName.toLocal8Bit();
+    if (suffix == "lsa")
+        mesh.loadLSA(path.constData(), triangulateScans);
+    else if (suffix == "cmsh")
+        mesh.loadCMSH(path.constData());
+    else
+        mesh.loadOBJ(path.constData());
+}
+
+void OpenGLView::loadMesh(const QString &fileName)
+{
+    if (!meshFileName.isEmpty())
+        meshFileWatcher.removePath(meshFileName);
+    meshFileName = fileName;
+    loadMeshFile(triMesh, meshFileName, scanTriangulation);
+    meshFileWatcher.addPath(meshFileName);
+    meshChanged();
+    update();
+}
+
+void OpenGLView::meshChanged()
+{
+    pointCloudDirty = true;
+    // baked occlusion belongs to the old geometry, a running bake as well
+    if (aoBake) {
+        aoBake->cancel();
+        aoBake.reset();
+    }
+    triMesh.setColors(vector<Vec3f>());
+    // raw scanner data without faces can only be shown as point cloud
+    const TriangleMesh &mesh = triMesh;
+    if (mesh.getTriangles().empty() && !mesh.getPoints().empty())
+        showPointCloud(true);
+}
+
+void OpenGLView::startMeshReload()
+{
+    if (meshReloadWatcher.isRunning()) {
+        meshReloadQueued = true;
+        return;
+    }
+
+    meshReloadTimer.start();
+    const QString fileName = meshFileName;
+    const bool triangulateScans = scanTriangulation;
+    const auto previous = std::make_shared<const MeshSnapshot>(triMesh.snapshot());
+    meshReloadWatcher.setFuture(QtConcurrent::run([fileName, triangulateScans, previous]() {
+        MeshReload reload;
+        reload.mesh = std::make_shared<TriangleMesh>();
+        loadMeshFile(*reload.mesh, fileName, triangulateScans);
+        const TriangleMesh &mesh = *reload.mesh;
+        reload.diff = mesh.diffReload(*previous);
+        return reload;
+    }));
+}
+
+void OpenGLView::finishMeshReload()
+{
+    // files replaced by renaming drop out of the watcher
+    if (!meshFileWatcher.files().contains(meshFileName) && QFileInfo::exists(meshFileName))
+        meshFileWatcher.addPath(meshFileName);
+
+    MeshReload reload = meshReloadWatcher.result();
+    // the future holds a copy of the result, drop it so the replaced data is freed with reload
+    meshReloadWatcher.setFuture(QFuture<MeshReload>());
+    const TriangleMesh &mesh = *reload.mesh;
+    if (mesh.getPoints().empty()) {
+        qDebug("Reload of %s failed, keeping the current mesh", qPrintable(meshFileName));
+    } else {
+        const bool rangesOnly = triMesh.reloadFrom(*reload.mesh, reload.diff);
+        qDebug("Reloaded %s in %lld ms (%s)", qPrintable(meshFileName), meshReloadTimer.elapsed(),
+               rangesOnly ? "changed ranges only" : "full upload");
+        meshUploadPending = true;
+        meshChanged();
+        update();
+    }
+
+    if (meshReloadQueued) {
+        meshReloadQueued = false;
+        startMeshReload();
+    }
 }
 
 void OpenGLView::initializeGL()
@@ -71,17 +193,17 @@ void OpenGLView::initializeGL()
 void OpenGLView::resizeGL(int w, int h)
 {
     // Calculate new projection matrix
-    QMatrix4x4 projectionMatrix;
     const float aspectRatio = static_cast<float>(w) / static_cast<float>(h);
-    projectionMatrix.perspective(65.f, aspectRatio, 0.1f, 100.f);
+    projectionMatrix = Mat4f::perspective(65.f, aspectRatio, 0.1f, 100.f);
 
     // Resize viewport
     f->glViewport(0, 0, w, h);
+    viewportWidth = w;
+    viewportHeight = h;
 
     // Set projection matrix
     f->glMatrixMode(GL_PROJECTION);
-    f->glLoadIdentity();
-    f->glMultMatrixf(projectionMatrix.constData());
+    f->glLoadMatrixf(projectionMatrix.constData());
     f->glMatrixMode(GL_MODELVIEW);
     f->glLoadIdentity();
 
@@ -90,19 +212,22 @@ void OpenGLView::resizeGL(int w, int h)
 
 void OpenGLView::paintGL()
 {
-    // clear and set camera
+    // clear and set camera: translate to centerPos, then rotate scene
     f->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    f->glLoadIdentity();
-
-    // translate to centerPos
-    f->glTranslatef(centerPos.x(), centerPos.y(), centerPos.z());
+    if (replaying) {
+        replayFrameTimer.start();
+        const vector<CameraEvent> &events = replayPath.events();
+        while (replayNextEvent < events.size() && events[replayNextEvent].time <= replayTime)
+            applyEvent(events[replayNextEvent++]);
+    }
+    viewMatrix = Mat4f::translation(centerPos) * Mat4f::rotation(angleX, Vec3f(0.f, 1.f, 0.f))
+            * Mat4f::rotation(angleY, Vec3f(1.f, 0.f, 0.f));
+    f->glLoadMatrixf(viewMatrix.constData());
 
     // disable lighting for coordinate system and light sphere
     f->glDisable(GL_LIGHTING);
 
-    // rotate scene, then render cs
-    f->glRotatef(angleX, 0.0f, 1.0f, 0.0f);
-    f->glRotatef(angleY, 1.0f, 0.0f, 0.0f);
+    // render cs
     drawCS();
 
     if (lightMoves) {
@@ -117,31 +242,90 @@ void OpenGLView::paintGL()
     f->glColor3f(1.f, 0.1f, 0.1f);
     f->glPushMatrix();
     f->glTranslatef(1.0f, 1.0f, 1.0f);
-    triMesh.draw(f);
+    if (pointCloudMode) {
+        drawPointCloud();
+    } else {
+        if (meshUploadPending) {
+            const size_t uploadedBytes = triMesh.uploadBuffers(f);
+            qDebug("Mesh reload visible after %lld ms, uploaded %zu bytes",
+                   meshReloadTimer.elapsed(), uploadedBytes);
+            meshUploadPending = false;
+        }
+        if (occlusionCulling) {
+            drawCulledMesh();
+        } else {
+            triMesh.draw(f);
+        }
+    }
     f->glPopMatrix();
+
+    if (replaying) {
+        // wait for the GPU so the frame time covers the whole frame
+        f->glFinish();
+        replayTimings.frameMs.push_back(replayFrameTimer.nsecsElapsed() * 1e-6);
+        replayTime += replayStep;
+        if (replayNextEvent == replayPath.events().size() && replayTime > replayPath.duration()) {
+            replaying = false;
+            // the replay advanced the light by the fixed step, continue in real time from here
+            deltaTimer.start();
+            qDebug("Replay finished: %zu frames, mean %.3f ms, 95%% %.3f ms, max %.3f ms",
+                   replayTimings.frameMs.size(), replayTimings.mean(),
+                   replayTimings.percentile(95.0), replayTimings.max());
+            emit replayFinished(replayTimings);
+        }
+    }
     ++frameCounter;
     update();
 
-    // Emit the triangle count to be shown in the UI.
-    emit triangleCountChanged(getTriangleCount());
+    reportStatistics();
+}
+
+void OpenGLView::reportStatistics()
+{
+    // Emit the triangle count, the culling result and the (cached) analytics of the object to be
+    // shown in the UI. Every signal rebuilds the status bar message, so only changes are sent.
+    const int triangleCount = static_cast<int>(getTriangleCount());
+    if (triangleCount != reportedTriangleCount) {
+        reportedTriangleCount = triangleCount;
+        emit triangleCountChanged(triangleCount);
+    }
+    const bool culling = occlusionCulling && !pointCloudMode;
+    const int visible = culling ? visibleTriangles : 0;
+    const int culled = culling ? culledTriangles : 0;
+    if (visible != reportedVisibleTriangles || culled != reportedCulledTriangles) {
+        reportedVisibleTriangles = visible;
+        reportedCulledTriangles = culled;
+        emit cullingStatisticsChanged(visible, culled);
+    }
+    if (triMesh.getRevision() != reportedStatisticsRevision) {
+        reportedStatisticsRevision = triMesh.getRevision();
+        emit meshStatisticsChanged(triMesh.getStatistics());
+    }
 }
 
 void OpenGLView::drawCS()
 {
-    f->glBegin(GL_LINES);
-    // red X
-    f->glColor3f(1.f, 0.f, 0.f);
-    f->glVertex3f(0.f, 0.f, 0.f);
-    f->glVertex3f(5.f, 0.f, 0.f);
-    // green Y
-    f->glColor3f(0.f, 1.f, 0.f);
-    f->glVertex3f(0.f, 0.f, 0.f);
-    f->glVertex3f(0.f, 5.f, 0.f);
-    // blue Z
-    f->glColor3f(0.f, 0.f, 1.f);
-    f->glVertex3f(0.f, 0.f, 0.f);
-    f->glVertex3f(0.f, 0.f, 5.f);
-    f->glEnd();
+    // rebuild the line buffer only when the mesh or the selection changed
+    if (sceneLines.empty() || sceneLinesDirty
+        || (normalsShown
+            && (triMesh.getRevision() != sceneLinesRevision
+                || triMesh.getNormalsRevision() != sceneLinesNormalsRevision))) {
+        sceneLines.clear();
+        sceneLines.addAxes(5.f);
+        if (normalsShown) {
+            // bounding box and vertex normals at the position the object is drawn at
+            const TriangleMesh &mesh = triMesh;
+            const MeshStatistics &stats = mesh.getStatistics();
+            const Vec3f offset(1.0f, 1.0f, 1.0f);
+            sceneLines.addBox(stats.bboxMin + offset, stats.bboxMax + offset,
+                              Vec3f(1.f, 1.f, 1.f));
+            mesh.drawNormals(sceneLines, 0.f, offset);
+        }
+        sceneLinesRevision = triMesh.getRevision();
+        sceneLinesNormalsRevision = triMesh.getNormalsRevision();
+        sceneLinesDirty = false;
+    }
+    sceneLines.draw(f);
 }
 
 void OpenGLView::drawLight()
@@ -159,9 +343,53 @@ void OpenGLView::drawLight()
     f->glPopMatrix();
 }
 
+void OpenGLView::drawPointCloud()
+{
+    if (pointCloudDirty) {
+        const TriangleMesh &mesh = triMesh;
+        pointCloud.build(mesh.getPoints());
+        pointCloudDirty = false;
+        // a reload shows up in the rebuilt point cloud, the mesh buffers follow when the mesh
+        // is drawn again
+        if (meshUploadPending) {
+            qDebug("Mesh reload visible after %lld ms as point cloud", meshReloadTimer.elapsed());
+            meshUploadPending = false;
+        }
+    }
+
+    // points have no normals, draw them unlit with the current color
+    f->glDisable(GL_LIGHTING);
+    f->glPointSize(1.f);
+    const Mat4f modelView = viewMatrix * Mat4f::translation(Vec3f(1.0f, 1.0f, 1.0f));
+    pointCloud.draw(f, modelView, projectionMatrix, viewportHeight);
+}
+
+void OpenGLView::drawCulledMesh()
+{
+    // the occluders are the largest clusters of the mesh itself
+    const TriangleMesh &mesh = triMesh;
+    const Mat4f modelViewProjection =
+            projectionMatrix * viewMatrix * Mat4f::translation(Vec3f(1.0f, 1.0f, 1.0f));
+    occlusionCuller.render(mesh, modelViewProjection, viewportWidth, viewportHeight);
+    occlusionCuller.cull(mesh, visibleClusters);
+
+    const vector<MeshCluster> &clusters = mesh.getClusters();
+    visibleTriangles = culledTriangles = 0;
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        if (visibleClusters[c])
+            visibleTriangles += clusters[c].count;
+        else
+            culledTriangles += clusters[c].count;
+    }
+    triMesh.drawClusters(f, visibleClusters);
+}
+
 void OpenGLView::moveLight()
 {
-    lightPos.rotY(lightMotionSpeed * (deltaTimer.restart() / 1000.f));
+    // a replay advances by the fixed timestep to be independent of the frame rate
+    const float seconds = replaying ? static_cast<float>(replayStep / 1000.0)
+                                    : deltaTimer.restart() / 1000.f;
+    lightPos.rotY(lightMotionSpeed * seconds);
 }
 
 unsigned int OpenGLView::getTriangleCount() const
@@ -171,6 +399,14 @@ unsigned int OpenGLView::getTriangleCount() const
 }
 
 void OpenGLView::setDefaults()
+{
+    if (replaying)
+        return;
+    recordEvent(CameraEvent::Reset);
+    resetView();
+}
+
+void OpenGLView::resetView()
 {
     // scene Information
     centerPos = Vec3f(1.0f, -2.0f, -5.0f);
@@ -193,20 +429,147 @@ void OpenGLView::recalcNormals(bool weightByAngle)
     update();
 }
 
+void OpenGLView::smoothMesh(bool cotangentWeights, bool taubin)
+{
+    const unsigned int iterations = 10;
+    QElapsedTimer timer;
+    timer.start();
+    triMesh.smooth(iterations, cotangentWeights, 0.5f, taubin ? -0.53f : 0.f);
+    qDebug("Smoothed %zu vertices with %u iterations in %lld ms",
+           static_cast<const TriangleMesh &>(triMesh).getPoints().size(), iterations,
+           timer.elapsed());
+    meshChanged();
+    update();
+}
+
+void OpenGLView::subdivideMesh(bool adaptive)
+{
+    vector<SubdivisionLevel> levels;
+    if (adaptive) {
+        // refine curved regions and triangles that appear large in the current view
+        AdaptiveSubdivision criteria;
+        criteria.curvatureAngle = 10.f;
+        criteria.maxScreenEdge = 8.f;
+        criteria.modelViewProjection =
+                projectionMatrix * viewMatrix * Mat4f::translation(Vec3f(1.0f, 1.0f, 1.0f));
+        criteria.viewportWidth = viewportWidth;
+        criteria.viewportHeight = viewportHeight;
+        levels = triMesh.subdivideLoop(1, &criteria);
+    } else {
+        levels = triMesh.subdivideLoop(1);
+    }
+    for (size_t i = 0; i < levels.size(); ++i) {
+        qDebug("Subdivision level %zu: %zu -> %zu triangles in %lld ms", i + 1,
+               levels[i].trianglesBefore, levels[i].trianglesAfter, levels[i].milliseconds);
+    }
+    meshChanged();
+    update();
+}
+
+void OpenGLView::bakeAmbientOcclusion()
+{
+    if (aoBake)
+        aoBake->cancel();
+    aoBakeWatcher.waitForFinished();
+
+    const TriangleMesh &mesh = triMesh;
+    if (mesh.getTriangles().empty() || mesh.getNormals().size() != mesh.getPoints().size())
+        return;
+    aoBake = std::make_shared<AmbientOcclusionBake>(mesh.getPoints(), mesh.getNormals(),
+                                                    mesh.getTriangles());
+    aoBakeRevision = mesh.getRevision();
+    aoBakeNormalsRevision = mesh.getNormalsRevision();
+    aoBakeTimer.start();
+    const std::shared_ptr<AmbientOcclusionBake> bake = aoBake;
+    aoBakeWatcher.setFuture(
+            QtConcurrent::run([bake]() { return bake->refine(AO_RAYS_PER_PASS); }));
+}
+
+void OpenGLView::finishAmbientOcclusionPass()
+{
+    const size_t rays = aoBakeWatcher.result();
+    if (!aoBake || rays == 0)
+        return;
+    if (triMesh.getRevision() != aoBakeRevision
+        || triMesh.getNormalsRevision() != aoBakeNormalsRevision) {
+        qDebug("Mesh changed, ambient occlusion bake stopped");
+        aoBake.reset();
+        return;
+    }
+
+    triMesh.setColors(aoBake->colors());
+    if (aoBake->samplesPerVertex() == AO_RAYS_PER_PASS)
+        qDebug("Ambient occlusion BVH built in %lld ms", aoBake->buildMilliseconds());
+    qDebug("Ambient occlusion: %u rays per vertex, %.2f Mrays/s, %lld ms total",
+           aoBake->samplesPerVertex(), aoBake->raysPerSecond() * 1e-6, aoBakeTimer.elapsed());
+    update();
+
+    // refine progressively until enough rays per vertex were cast
+    if (aoBake->samplesPerVertex() < AO_RAYS_TOTAL) {
+        const std::shared_ptr<AmbientOcclusionBake> bake = aoBake;
+        aoBakeWatcher.setFuture(
+                QtConcurrent::run([bake]() { return bake->refine(AO_RAYS_PER_PASS); }));
+    } else {
+        aoBake.reset();
+    }
+}
+
 void OpenGLView::triggerLightMovement(bool shouldMove)
 {
-    lightMoves = shouldMove;
-    if (lightMoves) {
-        if (deltaTimer.isValid()) {
-            deltaTimer.restart();
-        } else {
-            deltaTimer.start();
-        }
+    if (replaying)
+        return;
+    recordEvent(CameraEvent::Light, shouldMove ? 1.f : 0.f);
+    setLightMovement(shouldMove);
+}
+
+void OpenGLView::setLightMovement(bool shouldMove)
+{
+    // the first step after switching on must not include the time the light stood still
+    if (shouldMove)
+        deltaTimer.start();
+    if (lightMoves != shouldMove) {
+        lightMoves = shouldMove;
+        emit lightMovementChanged(lightMoves);
     }
 }
 
+void OpenGLView::showPointCloud(bool enabled)
+{
+    if (pointCloudMode == enabled)
+        return;
+    pointCloudMode = enabled;
+    emit pointCloudModeChanged(enabled);
+    update();
+}
+
+void OpenGLView::showNormals(bool enabled)
+{
+    normalsShown = enabled;
+    sceneLinesDirty = true;
+    update();
+}
+
+void OpenGLView::enableOcclusionCulling(bool enabled)
+{
+    occlusionCulling = enabled;
+    update();
+}
+
+void OpenGLView::enableScanTriangulation(bool enabled)
+{
+    if (scanTriangulation == enabled)
+        return;
+    scanTriangulation = enabled;
+    // only scans depend on the setting, reload them in the background
+    if (QFileInfo(meshFileName).suffix().toLower() == "lsa")
+        startMeshReload();
+}
+
 void OpenGLView::cameraMoves(float deltaX, float deltaY, float deltaZ)
 {
+    if (replaying)
+        return;
+    recordEvent(CameraEvent::Move, deltaX, deltaY, deltaZ);
     centerPos[0] += deltaX;
     centerPos[1] += deltaY;
     centerPos[2] += deltaZ;
@@ -216,6 +579,78 @@ void OpenGLView::cameraMoves(float deltaX, float deltaY, float deltaZ)
 
 void OpenGLView::cameraRotates(float deltaX, float deltaY)
 {
+    if (replaying)
+        return;
+    recordEvent(CameraEvent::Rotate, deltaX, deltaY);
     angleX = std::fmod(angleX + deltaX, 360.f);
     angleY += deltaY;
 }
+
+void OpenGLView::startRecording()
+{
+    recordedPath.clear();
+    recordedPath.initial.centerPos = centerPos;
+    recordedPath.initial.angleX = angleX;
+    recordedPath.initial.angleY = angleY;
+    recordedPath.initial.lightPos = lightPos;
+    recordedPath.initial.lightMoves = lightMoves;
+    recordTimer.start();
+    recording = true;
+}
+
+CameraPath OpenGLView::stopRecording()
+{
+    recording = false;
+    return recordedPath;
+}
+
+void OpenGLView::startReplay(const CameraPath &path, double stepMs)
+{
+    recording = false;
+    replayPath = path;
+    replayNextEvent = 0;
+    replayTime = 0.0;
+    replayStep = std::max(stepMs, 1e-3);
+    replayTimings.frameMs.clear();
+
+    resetView();
+    centerPos = path.initial.centerPos;
+    angleX = path.initial.angleX;
+    angleY = path.initial.angleY;
+    lightPos = path.initial.lightPos;
+    setLightMovement(path.initial.lightMoves);
+    replaying = true;
+    update();
+}
+
+void OpenGLView::recordEvent(CameraEvent::Type type, float x, float y, float z)
+{
+    if (!recording)
+        return;
+    CameraEvent event;
+    event.time = recordTimer.nsecsElapsed() * 1e-6;
+    event.type = type;
+    event.x = x;
+    event.y = y;
+    event.z = z;
+    recordedPath.add(event);
+}
+
+void OpenGLView::applyEvent(const CameraEvent &event)
+{
+    switch (event.type) {
+    case CameraEvent::Move:
+        centerPos += Vec3f(event.x, event.y, event.z);
+        break;
+    case CameraEvent::Rotate:
+        angleX = std::fmod(angleX + event.x, 360.f);
+        angleY += event.y;
+        break;
+    case CameraEvent::Light:
+        setLightMovement(event.x != 0.f);
+        break;
+    case CameraEvent::Reset:
+        resetView();
+        break;
+    }
+}
@@ -12,12 +12,22 @@
 #ifndef OPENGLVIEW_H
 #define OPENGLVIEW_H
 
+#include <memory>
+
 #include <QTimer>
 #include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
 #include <QOpenGLFunctions_2_1>
 #include <QObject>
 #include <QOpenGLWidget>
 
+#include "ambientocclusion.h"
+#include "camerapath.h"
+#include "debuglines.h"
+#include "matrix.h"
+#include "occlusionculler.h"
+#include "pointcloud.h"
 #include "trianglemesh.h"
 #include "vec3.h"
 
@@ -26,12 +36,33 @@ class OpenGLView : public QOpenGLWidget
     Q_OBJECT
 public:
     OpenGLView(QWidget *parent = nullptr);
+    ~OpenGLView();
+
+    // load the displayed mesh (OBJ, LSA or CMSH) and reload it whenever the file changes
+    void loadMesh(const QString &fileName);
+
+    // record the camera and light interaction from now on
+    void startRecording();
+    // stop recording and return the recorded path
+    CameraPath stopRecording();
+    // replay a recorded path with a fixed timestep instead of the wall clock: every frame
+    // advances the replay by stepMs and applies the events up to that time. user input is
+    // ignored meanwhile. the frame times (including glFinish) are passed to replayFinished().
+    void startReplay(const CameraPath &path, double stepMs = 1000.0 / 60.0);
+    bool isReplaying() const { return replaying; }
 
 public slots:
     void setDefaults();
     void refreshFpsCounter();
     void recalcNormals(bool weightByAngle = false);
+    void smoothMesh(bool cotangentWeights = false, bool taubin = false);
+    void subdivideMesh(bool adaptive = false);
+    void bakeAmbientOcclusion();
     void triggerLightMovement(bool shouldMove = true);
+    void showPointCloud(bool enabled = true);
+    void showNormals(bool enabled = true);
+    void enableOcclusionCulling(bool enabled = true);
+    void enableScanTriangulation(bool enabled = true);
     void cameraMoves(float deltaX, float deltaY, float deltaZ);
     void cameraRotates(float deltaX, float deltaY);
 
@@ -43,6 +74,19 @@ protected:
 signals:
     void fpsCountChanged(int newFps);
     void triangleCountChanged(int newTriangles);
+    // triangles of the mesh drawn and skipped by occlusion culling in the last frame, both 0 if
+    // it is off. the light sphere is not culled and not counted.
+    void cullingStatisticsChanged(int visibleTriangles, int culledTriangles);
+    void meshStatisticsChanged(const MeshStatistics &statistics);
+    void pointCloudModeChanged(bool enabled);
+    // the light movement was switched on or off, by the user or by a replayed event
+    void lightMovementChanged(bool enabled);
+    void replayFinished(const FrameTimings &timings);
+
+private slots:
+    void startMeshReload();
+    void finishMeshReload();
+    void finishAmbientOcclusionPass();
 
 private:
     QOpenGLFunctions_2_1 *f;
@@ -50,6 +94,10 @@ private:
     // scene Information
     Vec3f centerPos;
     float angleX, angleY;
+    Mat4f projectionMatrix;
+    Mat4f viewMatrix;
+    int viewportWidth = 1;
+    int viewportHeight = 1;
 
     // light information
     Vec3f lightPos;
@@ -59,6 +107,68 @@ private:
     TriangleMesh triMesh;
     TriangleMesh sphereMesh;
 
+    // hot reload of triMesh: the file is parsed and compared against a snapshot of triMesh on a
+    // worker thread after it settled for a moment, the GUI thread only swaps the data
+    struct MeshReload
+    {
+        std::shared_ptr<TriangleMesh> mesh;
+        MeshReloadDiff diff;
+    };
+    QString meshFileName;
+    QFileSystemWatcher meshFileWatcher;
+    QTimer meshReloadDelay;
+    QFutureWatcher<MeshReload> meshReloadWatcher;
+    QElapsedTimer meshReloadTimer;
+    bool meshReloadQueued = false;
+    bool meshUploadPending = false;
+    // LSA scans are loaded as raw points unless this is set
+    bool scanTriangulation = false;
+
+    // triMesh rendered as octree point cloud, used for face-less scanner data
+    PointCloud pointCloud;
+    bool pointCloudMode = false;
+    bool pointCloudDirty = true;
+
+    // hierarchical-Z occlusion culling of the clusters of triMesh, redone every frame
+    OcclusionCuller occlusionCuller;
+    bool occlusionCulling = false;
+    vector<unsigned char> visibleClusters;
+    int visibleTriangles = 0;
+    int culledTriangles = 0;
+
+    // progressive ambient occlusion bake of triMesh, one pass per future. the result is dropped
+    // if the mesh changed in the meantime.
+    std::shared_ptr<AmbientOcclusionBake> aoBake;
+    QFutureWatcher<size_t> aoBakeWatcher;
+    QElapsedTimer aoBakeTimer;
+    unsigned int aoBakeRevision = 0;
+    unsigned int aoBakeNormalsRevision = 0;
+
+    // coordinate system and, if normals are shown, the bounding box of triMesh
+    DebugLines sceneLines;
+    bool normalsShown = false;
+    bool sceneLinesDirty = true;
+    unsigned int sceneLinesRevision = 0;
+    unsigned int sceneLinesNormalsRevision = 0;
+
+    // interaction recording and fixed timestep replay
+    CameraPath recordedPath;
+    QElapsedTimer recordTimer;
+    bool recording = false;
+    CameraPath replayPath;
+    size_t replayNextEvent = 0;
+    double replayTime = 0.0;
+    double replayStep = 0.0;
+    bool replaying = false;
+    FrameTimings replayTimings;
+    QElapsedTimer replayFrameTimer;
+
+    // values last sent to the UI
+    int reportedTriangleCount = -1;
+    int reportedVisibleTriangles = -1;
+    int reportedCulledTriangles = -1;
+    unsigned int reportedStatisticsRevision = ~0u;
+
     // FPS counter, needed for FPS calculation
     unsigned int frameCounter = 0;
 
@@ -69,10 +179,21 @@ private:
     QElapsedTimer deltaTimer;
     bool lightMoves = false;
 
+    void resetView();
+    void recordEvent(CameraEvent::Type type, float x = 0.f, float y = 0.f, float z = 0.f);
+    void applyEvent(const CameraEvent &event);
     void drawCS();
     void drawLight();
+    void drawPointCloud();
+    void drawCulledMesh();
+    // drops everything derived from the geometry of triMesh after it was replaced or edited
+    void meshChanged();
     void moveLight();
+    // switches the light movement without recording it, restarts the frame delta timer
+    void setLightMovement(bool shouldMove);
+    void reportStatistics();
     unsigned int getTriangleCount() const;
+    static void loadMeshFile(TriangleMesh &mesh, const QString &fileName, bool triangulateScans);
 };
 
 #endif // OPENGLVIEW_H
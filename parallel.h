@@ -0,0 +1,93 @@
+// ========================================================================= //
+// Content: Minimal helpers for splitting loops across all CPU cores         //
+// ========================================================================= //
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// number of threads used by parallelFor (at least 1)
+inline unsigned int workerCount()
+{
+    const unsigned int n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+// Calls func(first, last) on disjoint sub-ranges covering [begin, end). Ranges are never smaller
+// than minChunk (except the last one), so small loops stay on the calling thread. The calling
+// thread processes the first range itself and returns after all ranges are done.
+template<typename Func>
+void parallelFor(size_t begin, size_t end, Func func, size_t minChunk = 4096)
+{
+    if (end <= begin)
+        return;
+    const size_t count = end - begin;
+    minChunk = std::max<size_t>(minChunk, 1);
+    const size_t maxThreads = (count + minChunk - 1) / minChunk;
+    const size_t threads = std::min<size_t>(workerCount(), maxThreads);
+    if (threads <= 1) {
+        func(begin, end);
+        return;
+    }
+
+    const size_t step = (count + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (size_t t = 1; t < threads; ++t) {
+        const size_t first = begin + t * step;
+        const size_t last = std::min(end, first + step);
+        if (first >= last)
+            break;
+        workers.emplace_back(func, first, last);
+    }
+    func(begin, std::min(end, begin + step));
+    for (auto &worker : workers)
+        worker.join();
+}
+
+// Sorts data on all cores: blocks are sorted in parallel, then neighbouring blocks are merged
+// pairwise (again in parallel) until a single sorted range remains.
+template<typename T, typename Compare>
+void parallelSort(std::vector<T> &data, Compare comp)
+{
+    const size_t count = data.size();
+    const size_t blocks = std::min<size_t>(workerCount(), std::max<size_t>(1, count / 65536));
+    if (blocks <= 1) {
+        std::sort(data.begin(), data.end(), comp);
+        return;
+    }
+
+    std::vector<size_t> bounds(blocks + 1);
+    for (size_t b = 0; b <= blocks; ++b)
+        bounds[b] = b * count / blocks;
+    const auto begin = data.begin();
+    parallelFor(
+            0, blocks,
+            [&](size_t first, size_t last) {
+                for (size_t b = first; b < last; ++b)
+                    std::sort(begin + bounds[b], begin + bounds[b + 1], comp);
+            },
+            1);
+    for (size_t width = 1; width < blocks; width *= 2) {
+        const size_t pairs = (blocks + 2 * width - 1) / (2 * width);
+        parallelFor(
+                0, pairs,
+                [&](size_t first, size_t last) {
+                    for (size_t p = first; p < last; ++p) {
+                        const size_t lo = 2 * width * p;
+                        const size_t mid = std::min(lo + width, blocks);
+                        const size_t hi = std::min(lo + 2 * width, blocks);
+                        if (mid < hi)
+                            std::inplace_merge(begin + bounds[lo], begin + bounds[mid],
+                                               begin + bounds[hi], comp);
+                    }
+                },
+                1);
+    }
+}
+
+#endif // PARALLEL_H
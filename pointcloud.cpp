@@ -0,0 +1,249 @@
+// ========================================================================= //
+// Content: Octree based level of detail rendering of large point clouds     //
+// ========================================================================= //
+
+#include <algorithm>
+#include <cfloat>
+#include <mutex>
+#include <queue>
+#include <utility>
+
+#include "morton.h"
+#include "parallel.h"
+#include "pointcloud.h"
+
+void PointCloud::clear()
+{
+    points.clear();
+    nodes.clear();
+    pointCount = 0;
+    bufferDirty = true;
+}
+
+void PointCloud::build(const vector<Vec3f> &sourcePoints)
+{
+    clear();
+    if (sourcePoints.empty() || sourcePoints.size() > UINT32_MAX / 2)
+        return;
+    pointCount = sourcePoints.size();
+
+    // bounding cube
+    Vec3f bboxMin(FLT_MAX), bboxMax(-FLT_MAX);
+    std::mutex bboxMutex;
+    parallelFor(0, pointCount, [&](size_t first, size_t last) {
+        Vec3f localMin(FLT_MAX), localMax(-FLT_MAX);
+        for (size_t i = first; i < last; ++i) {
+            for (unsigned int axis = 0; axis < 3; ++axis) {
+                localMin[axis] = std::min(localMin[axis], sourcePoints[i][axis]);
+                localMax[axis] = std::max(localMax[axis], sourcePoints[i][axis]);
+            }
+        }
+        std::lock_guard<std::mutex> lock(bboxMutex);
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            bboxMin[axis] = std::min(bboxMin[axis], localMin[axis]);
+            bboxMax[axis] = std::max(bboxMax[axis], localMax[axis]);
+        }
+    });
+    const Vec3f extent = bboxMax - bboxMin;
+    const float size = std::max(std::max(extent.x(), extent.y()), std::max(extent.z(), EPS));
+
+    // morton codes, sorted together with the point index
+    const float scale = ((1u << MORTON_BITS) - 1) / size;
+    vector<pair<uint64_t, uint32_t>> keys(pointCount);
+    parallelFor(0, pointCount, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+            keys[i] = make_pair(mortonCode(sourcePoints[i], bboxMin, scale),
+                                static_cast<uint32_t>(i));
+    });
+    parallelSort(keys, [](const pair<uint64_t, uint32_t> &a, const pair<uint64_t, uint32_t> &b) {
+        return a.first < b.first;
+    });
+
+    vector<uint64_t> codes(pointCount);
+    points.resize(pointCount);
+    parallelFor(0, pointCount, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            codes[i] = keys[i].first;
+            points[i] = sourcePoints[keys[i].second];
+        }
+    });
+    vector<pair<uint64_t, uint32_t>>().swap(keys);
+
+    // the hierarchy itself is small (about one node per LEAF_SIZE points), build it serially
+    Node root;
+    root.halfSize = 0.5f * size;
+    root.center = bboxMin + Vec3f(root.halfSize);
+    root.first = 0;
+    root.count = static_cast<uint32_t>(pointCount);
+    nodes.push_back(root);
+    buildNode(0, 0, codes);
+
+    // subsamples of inner nodes are appended behind the sorted points
+    size_t repTotal = pointCount;
+    for (auto &node : nodes) {
+        if (node.childCount == 0) {
+            node.repFirst = node.first;
+            node.repCount = node.count;
+        } else {
+            node.repFirst = static_cast<uint32_t>(repTotal);
+            node.repCount = std::min(node.count, LEAF_SIZE);
+            repTotal += node.repCount;
+        }
+        node.spacing = 2.f * node.halfSize / std::sqrt(static_cast<float>(node.repCount));
+    }
+    points.resize(repTotal);
+    parallelFor(
+            0, nodes.size(),
+            [&](size_t first, size_t last) {
+                for (size_t n = first; n < last; ++n) {
+                    const Node &node = nodes[n];
+                    if (node.childCount == 0)
+                        continue;
+                    for (uint32_t i = 0; i < node.repCount; ++i)
+                        points[node.repFirst + i] =
+                                points[node.first + uint64_t(i) * node.count / node.repCount];
+                }
+            },
+            16);
+}
+
+void PointCloud::buildNode(uint32_t nodeIndex, unsigned int level, const vector<uint64_t> &codes)
+{
+    nodes[nodeIndex].firstChild = 0;
+    nodes[nodeIndex].childCount = 0;
+    const Node node = nodes[nodeIndex];
+    if (node.count <= LEAF_SIZE || level == MORTON_BITS)
+        return;
+
+    // the points of a node share their code prefix, the next three bits select the child
+    const unsigned int shift = 3 * (MORTON_BITS - 1 - level);
+    const auto begin = codes.begin() + node.first;
+    const auto end = begin + node.count;
+    const uint32_t firstChild = static_cast<uint32_t>(nodes.size());
+    auto childBegin = begin;
+    for (unsigned int octant = 0; octant < 8 && childBegin != end; ++octant) {
+        const auto childEnd = std::partition_point(childBegin, end, [&](uint64_t code) {
+            return ((code >> shift) & 7) <= octant;
+        });
+        if (childEnd == childBegin)
+            continue;
+        Node child;
+        child.halfSize = 0.5f * node.halfSize;
+        child.center = node.center
+                + Vec3f((octant & 1) ? child.halfSize : -child.halfSize,
+                        (octant & 2) ? child.halfSize : -child.halfSize,
+                        (octant & 4) ? child.halfSize : -child.halfSize);
+        child.first = static_cast<uint32_t>(childBegin - codes.begin());
+        child.count = static_cast<uint32_t>(childEnd - childBegin);
+        nodes.push_back(child);
+        childBegin = childEnd;
+    }
+    const uint32_t childCount = static_cast<uint32_t>(nodes.size()) - firstChild;
+    nodes[nodeIndex].firstChild = firstChild;
+    nodes[nodeIndex].childCount = childCount;
+    for (uint32_t c = 0; c < childCount; ++c)
+        buildNode(firstChild + c, level + 1, codes);
+}
+
+size_t PointCloud::draw(QOpenGLFunctions_2_1 *f, const Mat4f &modelView, const Mat4f &projection,
+                        int viewportHeight)
+{
+    if (nodes.empty())
+        return 0;
+
+    if (vertexBuffer == 0) {
+        f->glGenBuffers(1, &vertexBuffer);
+        bufferDirty = true;
+    }
+    if (bufferDirty) {
+        f->glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        f->glBufferData(GL_ARRAY_BUFFER, points.size() * sizeof(Vec3f), points.data(),
+                        GL_STATIC_DRAW);
+        bufferDirty = false;
+    }
+
+    // screen space error: projected point spacing in pixels
+    const Mat4f mvp = projection * modelView;
+    const Vec3f eye = modelView.inverted().translation();
+    const float pixelsPerUnit = 0.5f * projection(1, 1) * viewportHeight;
+    const auto visible = [&](const Node &node) {
+        // outside if all corners of the node lie behind the same clip plane
+        int outside[6] = { 0, 0, 0, 0, 0, 0 };
+        for (unsigned int corner = 0; corner < 8; ++corner) {
+            const Vec3f p = node.center
+                    + Vec3f((corner & 1) ? node.halfSize : -node.halfSize,
+                            (corner & 2) ? node.halfSize : -node.halfSize,
+                            (corner & 4) ? node.halfSize : -node.halfSize);
+            float clip[4];
+            mvp.transformPoint(p, clip);
+            for (unsigned int axis = 0; axis < 3; ++axis) {
+                outside[2 * axis] += clip[axis] < -clip[3];
+                outside[2 * axis + 1] += clip[axis] > clip[3];
+            }
+        }
+        for (int plane : outside) {
+            if (plane == 8)
+                return false;
+        }
+        return true;
+    };
+    const auto screenError = [&](const Node &node) {
+        const float distance = std::max(node.center.distance(eye) - 1.7321f * node.halfSize, EPS);
+        return node.spacing * pixelsPerUnit / distance;
+    };
+
+    // refine the node with the largest error first until the error or the budget is reached
+    typedef pair<float, uint32_t> Candidate;
+    priority_queue<Candidate> queue;
+    vector<GLint> firsts;
+    vector<GLsizei> counts;
+    size_t budgetUsed = 0;
+    if (visible(nodes[0])) {
+        queue.push(Candidate(screenError(nodes[0]), 0));
+        budgetUsed = nodes[0].repCount;
+    }
+    vector<uint32_t> visibleChildren;
+    while (!queue.empty()) {
+        const Candidate candidate = queue.top();
+        queue.pop();
+        const Node &node = nodes[candidate.second];
+        if (candidate.first > maxScreenError && node.childCount > 0) {
+            visibleChildren.clear();
+            size_t childPoints = 0;
+            for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; ++c) {
+                if (visible(nodes[c])) {
+                    visibleChildren.push_back(c);
+                    childPoints += nodes[c].repCount;
+                }
+            }
+            if (budgetUsed - node.repCount + childPoints <= pointBudget) {
+                budgetUsed = budgetUsed - node.repCount + childPoints;
+                for (uint32_t c : visibleChildren)
+                    queue.push(Candidate(screenError(nodes[c]), c));
+                continue;
+            }
+        }
+        firsts.push_back(static_cast<GLint>(node.repFirst));
+        counts.push_back(static_cast<GLsizei>(node.repCount));
+    }
+
+    if (!firsts.empty()) {
+        f->glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        f->glEnableClientState(GL_VERTEX_ARRAY);
+        f->glVertexPointer(3, GL_FLOAT, 0, nullptr);
+        f->glMultiDrawArrays(GL_POINTS, firsts.data(), counts.data(),
+                             static_cast<GLsizei>(firsts.size()));
+        f->glDisableClientState(GL_VERTEX_ARRAY);
+    }
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return budgetUsed;
+}
+
+void PointCloud::releaseBuffers(QOpenGLFunctions_2_1 *f)
+{
+    if (vertexBuffer == 0)
+        return;
+    f->glDeleteBuffers(1, &vertexBuffer);
+    vertexBuffer = 0;
+    bufferDirty = true;
+}
@@ -0,0 +1,72 @@
+// ========================================================================= //
+// Content: Octree based level of detail rendering of large point clouds     //
+// ========================================================================= //
+
+#ifndef POINTCLOUD_H
+#define POINTCLOUD_H
+
+#include <cstdint>
+#include <vector>
+
+#include <QOpenGLFunctions_2_1>
+
+#include "matrix.h"
+#include "vec3.h"
+
+using namespace std;
+
+class PointCloud
+{
+private:
+    // Points are sorted along a Morton curve, so every octree node covers a contiguous range of
+    // them. Inner nodes additionally own an evenly strided subsample of their range, which is
+    // stored behind the sorted points and drawn instead of the children until the projected
+    // point spacing becomes too coarse.
+    struct Node
+    {
+        Vec3f center;
+        float halfSize;
+        uint32_t first, count; // range in the sorted points
+        uint32_t repFirst, repCount; // points drawn for this node
+        uint32_t firstChild, childCount; // children are stored consecutively
+        float spacing; // approximate distance of the drawn points
+    };
+
+    vector<Vec3f> points;
+    vector<Node> nodes;
+    size_t pointCount = 0;
+
+    // level of detail settings
+    size_t pointBudget = 5000000;
+    float maxScreenError = 2.f;
+
+    GLuint vertexBuffer = 0;
+    bool bufferDirty = true;
+
+    void buildNode(uint32_t nodeIndex, unsigned int level, const vector<uint64_t> &codes);
+
+public:
+    static const uint32_t LEAF_SIZE = 8192;
+
+    // build the octree over the given points. morton codes, sorting and subsampling run in
+    // parallel.
+    void build(const vector<Vec3f> &sourcePoints);
+    void clear();
+
+    size_t size() const { return pointCount; }
+    bool empty() const { return pointCount == 0; }
+
+    // maximum number of points drawn per frame
+    void setPointBudget(size_t budget) { pointBudget = budget; }
+    // refine nodes until their projected point spacing is below this many pixels
+    void setMaxScreenError(float pixels) { maxScreenError = pixels; }
+
+    // draw the visible nodes with the required detail. returns the number of points drawn.
+    size_t draw(QOpenGLFunctions_2_1 *f, const Mat4f &modelView, const Mat4f &projection,
+                int viewportHeight);
+
+    // delete the GPU buffer, needs a current context
+    void releaseBuffers(QOpenGLFunctions_2_1 *f);
+};
+
+#endif // POINTCLOUD_H
@@ -0,0 +1,255 @@
+// ========================================================================= //
+// Content: Tests of camera path files, frame time statistics and the check  //
+// ========================================================================= //
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "camerapath.h"
+
+using namespace std;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition)                                                                          \
+    do {                                                                                          \
+        if (!(condition)) {                                                                       \
+            cout << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << endl;         \
+            ++failures;                                                                           \
+        }                                                                                         \
+    } while (false)
+
+// files are written to the working directory of the test and removed again
+const char *const PATH_FILE = "camerapath_test.path";
+const char *const CSV_FILE = "camerapath_test.csv";
+
+void writeFile(const char *filename, const string &content)
+{
+    ofstream out(filename);
+    out << content;
+}
+
+FrameTimings timings(const vector<double> &frameMs)
+{
+    FrameTimings result;
+    result.frameMs = frameMs;
+    return result;
+}
+
+// nearest rank: the smallest value with at least p percent of all values at or below it
+void testPercentile()
+{
+    const FrameTimings none;
+    CHECK(none.percentile(95.0) == 0.0);
+    CHECK(none.mean() == 0.0);
+    CHECK(none.max() == 0.0);
+
+    // 1..100 in scrambled order
+    FrameTimings hundred;
+    for (int i = 0; i < 100; ++i)
+        hundred.frameMs.push_back((i * 37) % 100 + 1);
+    CHECK(hundred.percentile(0.0) == 1.0);
+    CHECK(hundred.percentile(1.0) == 1.0);
+    CHECK(hundred.percentile(50.0) == 50.0);
+    CHECK(hundred.percentile(95.0) == 95.0);
+    CHECK(hundred.percentile(95.5) == 96.0);
+    CHECK(hundred.percentile(100.0) == 100.0);
+    // out of range p is clamped
+    CHECK(hundred.percentile(-5.0) == 1.0);
+    CHECK(hundred.percentile(250.0) == 100.0);
+    CHECK(hundred.mean() == 50.5);
+    CHECK(hundred.max() == 100.0);
+
+    const FrameTimings four = timings({ 4.0, 1.0, 3.0, 2.0 });
+    CHECK(four.percentile(25.0) == 1.0);
+    CHECK(four.percentile(26.0) == 2.0);
+    CHECK(four.percentile(75.0) == 3.0);
+    CHECK(four.percentile(95.0) == 4.0);
+    // the frame times themselves stay in recording order
+    CHECK(four.frameMs[0] == 4.0 && four.frameMs[3] == 2.0);
+
+    const FrameTimings single = timings({ 7.5 });
+    CHECK(single.percentile(0.0) == 7.5);
+    CHECK(single.percentile(100.0) == 7.5);
+}
+
+void testCheckFrameTimings()
+{
+    // mean 10, 95th percentile 19
+    vector<double> frames(20, 10.0);
+    frames[0] = frames[1] = 1.0;
+    frames[18] = frames[19] = 19.0;
+    const FrameTimings run = timings(frames);
+    CHECK(run.mean() == 10.0);
+    CHECK(run.percentile(95.0) == 19.0);
+
+    FrameTimingThresholds thresholds;
+    CHECK(checkFrameTimings(run, nullptr, thresholds).empty());
+    CHECK(checkFrameTimings(FrameTimings(), nullptr, thresholds).size() == 1);
+
+    thresholds.maxMeanMs = 10.0;
+    thresholds.maxP95Ms = 19.0;
+    CHECK(checkFrameTimings(run, nullptr, thresholds).empty());
+    thresholds.maxMeanMs = 9.9;
+    CHECK(checkFrameTimings(run, nullptr, thresholds).size() == 1);
+    thresholds.maxP95Ms = 18.9;
+    vector<string> messages = checkFrameTimings(run, nullptr, thresholds);
+    CHECK(messages.size() == 2);
+    CHECK(!messages.empty() && messages[0].find("mean frame time") == 0);
+    CHECK(messages.size() == 2 && messages[1].find("95th percentile") == 0);
+
+    // regression against a baseline with mean 8 and 95th percentile 16: 25% and 18.75% slower
+    thresholds = FrameTimingThresholds();
+    vector<double> baseFrames(20, 8.0);
+    baseFrames[0] = baseFrames[1] = 0.0;
+    baseFrames[18] = baseFrames[19] = 16.0;
+    const FrameTimings baseline = timings(baseFrames);
+    thresholds.maxRegressionPercent = 30.0;
+    CHECK(checkFrameTimings(run, &baseline, thresholds).empty());
+    thresholds.maxRegressionPercent = 20.0;
+    messages = checkFrameTimings(run, &baseline, thresholds);
+    CHECK(messages.size() == 1 && messages[0].find("mean frame time") == 0);
+    thresholds.maxRegressionPercent = 10.0;
+    CHECK(checkFrameTimings(run, &baseline, thresholds).size() == 2);
+    // without a baseline, or with an empty one, the regression limit is not checked
+    CHECK(checkFrameTimings(run, nullptr, thresholds).empty());
+    const FrameTimings emptyBaseline;
+    CHECK(checkFrameTimings(run, &emptyBaseline, thresholds).empty());
+    // a faster run never fails the regression check
+    CHECK(checkFrameTimings(baseline, &run, thresholds).empty());
+}
+
+void testPathRoundTrip()
+{
+    CameraPath path;
+    path.initial.centerPos = Vec3f(0.1f, -2.f, -10.f);
+    path.initial.angleX = 33.333f;
+    path.initial.angleY = -1e-7f;
+    path.initial.lightPos = Vec3f(5.f, 3.f, 5.f);
+    path.initial.lightMoves = true;
+    const CameraEvent::Type types[] = { CameraEvent::Move, CameraEvent::Rotate,
+                                        CameraEvent::Light, CameraEvent::Reset };
+    for (int i = 0; i < 40; ++i) {
+        CameraEvent event;
+        event.time = i * 16.6666667 + 0.000123;
+        event.type = types[i % 4];
+        event.x = 0.1f * i;
+        event.y = -1.f / (i + 1);
+        event.z = i % 3 == 0 ? 0.f : 3.14159265f;
+        path.add(event);
+    }
+    CHECK(path.save(PATH_FILE));
+
+    CameraPath loaded;
+    CHECK(loaded.load(PATH_FILE));
+    CHECK(loaded.initial.centerPos == path.initial.centerPos);
+    CHECK(loaded.initial.angleX == path.initial.angleX);
+    CHECK(loaded.initial.angleY == path.initial.angleY);
+    CHECK(loaded.initial.lightPos == path.initial.lightPos);
+    CHECK(loaded.initial.lightMoves);
+    CHECK(loaded.events().size() == path.events().size());
+    bool eventsEqual = loaded.events().size() == path.events().size();
+    for (size_t i = 0; eventsEqual && i < path.events().size(); ++i) {
+        const CameraEvent &a = path.events()[i], &b = loaded.events()[i];
+        eventsEqual = std::fabs(a.time - b.time) < 1e-6 && a.type == b.type && a.x == b.x
+                && a.y == b.y && a.z == b.z;
+    }
+    CHECK(eventsEqual);
+    CHECK(loaded.duration() == loaded.events().back().time);
+
+    // a recording without events is valid
+    CameraPath empty;
+    CHECK(empty.save(PATH_FILE));
+    CHECK(loaded.load(PATH_FILE));
+    CHECK(loaded.empty());
+    CHECK(loaded.duration() == 0.0);
+    CHECK(!loaded.initial.lightMoves);
+}
+
+void testMalformedPaths()
+{
+    const string header = "camerapath 1\n";
+    const string initial = "initial 0 0 -10 0 0 5 3 5 0\n";
+
+    CameraPath path;
+    CHECK(!path.load("camerapath_test_missing.path"));
+
+    // a failed load leaves the path empty
+    path.add(CameraEvent());
+    writeFile(PATH_FILE, "");
+    CHECK(!path.load(PATH_FILE));
+    CHECK(path.empty());
+
+    writeFile(PATH_FILE, "camerapath 2\n" + initial);
+    CHECK(!path.load(PATH_FILE));
+    writeFile(PATH_FILE, header);
+    CHECK(!path.load(PATH_FILE));
+    writeFile(PATH_FILE, header + "start 0 0 -10 0 0 5 3 5 0\n");
+    CHECK(!path.load(PATH_FILE));
+    writeFile(PATH_FILE, header + "initial 0 0 -10 0 0 5 3\n");
+    CHECK(!path.load(PATH_FILE));
+    writeFile(PATH_FILE, header + initial + "10 zoom 1 0 0\n");
+    CHECK(!path.load(PATH_FILE));
+    writeFile(PATH_FILE, header + initial + "10 move 1 0\n");
+    CHECK(!path.load(PATH_FILE));
+    writeFile(PATH_FILE, header + initial + "ten move 1 0 0\n");
+    CHECK(!path.load(PATH_FILE));
+    // timestamps must not decrease
+    writeFile(PATH_FILE, header + initial + "10 move 1 0 0\n5 move 1 0 0\n");
+    CHECK(!path.load(PATH_FILE));
+    CHECK(path.empty());
+
+    // empty lines are skipped, equal timestamps are fine
+    writeFile(PATH_FILE, header + initial + "\n10 move 1 0 0\n\n10 light 1 0 0\n20 reset 0 0 0\n");
+    CHECK(path.load(PATH_FILE));
+    CHECK(path.events().size() == 3);
+    CHECK(path.events().size() == 3 && path.events()[1].type == CameraEvent::Light
+          && path.events()[2].type == CameraEvent::Reset);
+    CHECK(path.duration() == 20.0);
+    std::remove(PATH_FILE);
+}
+
+void testTimingsCsv()
+{
+    const FrameTimings run = timings({ 16.6667, 0.5, 120.25 });
+    CHECK(run.saveCsv(CSV_FILE));
+    FrameTimings loaded;
+    CHECK(loaded.loadCsv(CSV_FILE));
+    CHECK(loaded.frameMs.size() == 3);
+    // four decimals are written
+    CHECK(loaded.frameMs.size() == 3 && loaded.frameMs[0] == 16.6667 && loaded.frameMs[1] == 0.5
+          && loaded.frameMs[2] == 120.25);
+
+    // lines without a value are skipped, a file without frames is rejected
+    writeFile(CSV_FILE, "frame,ms\n0,1.5\nbroken\n1,\n2,2.5\n");
+    CHECK(loaded.loadCsv(CSV_FILE));
+    CHECK(loaded.frameMs.size() == 2);
+    writeFile(CSV_FILE, "frame,ms\n");
+    CHECK(!loaded.loadCsv(CSV_FILE));
+    CHECK(loaded.frameMs.empty());
+    CHECK(!loaded.loadCsv("camerapath_test_missing.csv"));
+    std::remove(CSV_FILE);
+}
+
+} // namespace
+
+int main()
+{
+    testPercentile();
+    testCheckFrameTimings();
+    testPathRoundTrip();
+    testMalformedPaths();
+    testTimingsCsv();
+    if (failures > 0) {
+        cout << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "all checks passed" << endl;
+    return 0;
+}
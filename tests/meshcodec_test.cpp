@@ -0,0 +1,274 @@
+// ========================================================================= //
+// Content: Round-trip and corruption tests of the CMSH mesh codec           //
+// ========================================================================= //
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "meshcodec.h"
+
+using namespace std;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition)                                                                          \
+    do {                                                                                          \
+        if (!(condition)) {                                                                       \
+            cout << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << endl;         \
+            ++failures;                                                                           \
+        }                                                                                         \
+    } while (false)
+
+// wavy height field of (n + 1) x (n + 1) vertices
+void makeGrid(unsigned int n, vector<Vec3f> &vertices, vector<Vec3i> &triangles)
+{
+    vertices.clear();
+    triangles.clear();
+    for (unsigned int y = 0; y <= n; ++y) {
+        for (unsigned int x = 0; x <= n; ++x) {
+            vertices.push_back(Vec3f(x * 0.01f, y * 0.01f,
+                                     0.1f * std::sin(x * 0.05f) * std::cos(y * 0.07f)));
+        }
+    }
+    for (unsigned int y = 0; y < n; ++y) {
+        for (unsigned int x = 0; x < n; ++x) {
+            const int v = static_cast<int>(y * (n + 1) + x);
+            triangles.push_back(Vec3i(v, v + 1, v + static_cast<int>(n) + 2));
+            triangles.push_back(Vec3i(v, v + static_cast<int>(n) + 2, v + static_cast<int>(n) + 1));
+        }
+    }
+}
+
+size_t objSize(const vector<Vec3f> &vertices, const vector<Vec3i> &triangles)
+{
+    ostringstream obj;
+    for (const auto &v : vertices)
+        obj << "v " << v.x() << ' ' << v.y() << ' ' << v.z() << '\n';
+    for (const auto &t : triangles)
+        obj << "f " << t.x() + 1 << ' ' << t.y() + 1 << ' ' << t.z() + 1 << '\n';
+    return obj.str().size();
+}
+
+// decodes buffer and compares against the original mesh. the decoder renumbers vertices, so
+// triangles must be identical up to a consistent one-to-one mapping of the vertex indices.
+void checkRoundTrip(const vector<Vec3f> &vertices, const vector<Vec3i> &triangles,
+                    const vector<unsigned char> &buffer, unsigned int quantizationBits)
+{
+    vector<Vec3f> decodedVertices;
+    vector<Vec3i> decodedTriangles;
+    CHECK(MeshCodec::decode(buffer.data(), buffer.size(), decodedVertices, decodedTriangles));
+    CHECK(decodedVertices.size() == vertices.size());
+    CHECK(decodedTriangles.size() == triangles.size());
+    if (decodedVertices.size() != vertices.size() || decodedTriangles.size() != triangles.size())
+        return;
+
+    Vec3f bboxMin(vertices.empty() ? 0.f : vertices[0].x()), bboxMax = bboxMin;
+    for (const auto &v : vertices) {
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            bboxMin[axis] = std::min(bboxMin[axis], v[axis]);
+            bboxMax[axis] = std::max(bboxMax[axis], v[axis]);
+        }
+    }
+    Vec3f step;
+    for (unsigned int axis = 0; axis < 3; ++axis)
+        step[axis] = (bboxMax[axis] - bboxMin[axis]) / ((1u << quantizationBits) - 1) + 1e-6f;
+    const auto closeEnough = [&](const Vec3f &a, const Vec3f &b) {
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            if (std::fabs(a[axis] - b[axis]) > step[axis])
+                return false;
+        }
+        return true;
+    };
+
+    vector<int> toDecoded(vertices.size(), -1), toOriginal(vertices.size(), -1);
+    bool consistent = true, positionsClose = true;
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        for (unsigned int k = 0; k < 3; ++k) {
+            const int original = triangles[t][k], decoded = decodedTriangles[t][k];
+            if (decoded < 0 || size_t(decoded) >= vertices.size()) {
+                consistent = false;
+                continue;
+            }
+            if (toDecoded[original] < 0 && toOriginal[decoded] < 0) {
+                toDecoded[original] = decoded;
+                toOriginal[decoded] = original;
+            }
+            consistent = consistent && toDecoded[original] == decoded
+                    && toOriginal[decoded] == original;
+            positionsClose = positionsClose
+                    && closeEnough(vertices[original], decodedVertices[decoded]);
+        }
+    }
+    CHECK(consistent);
+    CHECK(positionsClose);
+
+    // unreferenced vertices keep their relative order and are stored after all others
+    vector<Vec3f> unreferencedOriginal, unreferencedDecoded;
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        if (toDecoded[i] < 0)
+            unreferencedOriginal.push_back(vertices[i]);
+        if (toOriginal[i] < 0)
+            unreferencedDecoded.push_back(decodedVertices[i]);
+    }
+    CHECK(unreferencedOriginal.size() == unreferencedDecoded.size());
+    for (size_t i = 0; i < std::min(unreferencedOriginal.size(), unreferencedDecoded.size()); ++i)
+        CHECK(closeEnough(unreferencedOriginal[i], unreferencedDecoded[i]));
+}
+
+bool rejects(const vector<unsigned char> &buffer)
+{
+    vector<Vec3f> vertices;
+    vector<Vec3i> triangles;
+    const bool ok = MeshCodec::decode(buffer.data(), buffer.size(), vertices, triangles);
+    // a failed decode leaves both vectors empty
+    return !ok && vertices.empty() && triangles.empty();
+}
+
+void testGrid()
+{
+    vector<Vec3f> vertices;
+    vector<Vec3i> triangles;
+    makeGrid(300, vertices, triangles);
+    vector<unsigned char> buffer;
+    CHECK(MeshCodec::encode(vertices, triangles, buffer));
+    checkRoundTrip(vertices, triangles, buffer, MeshCodec::DEFAULT_QUANTIZATION_BITS);
+
+    const double ratio = double(objSize(vertices, triangles)) / buffer.size();
+    cout << "grid: " << vertices.size() << " vertices, " << buffer.size() << " bytes, "
+         << ratio << "x smaller than OBJ" << endl;
+    CHECK(ratio >= 5.0);
+
+    for (unsigned int bits : { 1u, 8u, 30u }) {
+        CHECK(MeshCodec::encode(vertices, triangles, buffer, bits));
+        checkRoundTrip(vertices, triangles, buffer, bits);
+    }
+}
+
+void testEmptyMesh()
+{
+    vector<unsigned char> buffer;
+    CHECK(MeshCodec::encode({}, {}, buffer));
+    vector<Vec3f> vertices(3);
+    vector<Vec3i> triangles(1);
+    CHECK(MeshCodec::decode(buffer.data(), buffer.size(), vertices, triangles));
+    CHECK(vertices.empty());
+    CHECK(triangles.empty());
+}
+
+void testUnreferencedVertices()
+{
+    vector<Vec3f> vertices;
+    vector<Vec3i> triangles;
+    makeGrid(20, vertices, triangles);
+    // drop every third triangle, which leaves some grid vertices unused, and add loose points
+    vector<Vec3i> kept;
+    for (size_t t = 0; t < triangles.size(); ++t) {
+        if (t % 3 != 0)
+            kept.push_back(triangles[t]);
+    }
+    vertices.push_back(Vec3f(-1.f, 2.f, 0.5f));
+    vertices.insert(vertices.begin(), Vec3f(3.f, -2.f, 1.f));
+    for (auto &t : kept)
+        t = Vec3i(t.x() + 1, t.y() + 1, t.z() + 1);
+    vector<unsigned char> buffer;
+    CHECK(MeshCodec::encode(vertices, kept, buffer));
+    checkRoundTrip(vertices, kept, buffer, MeshCodec::DEFAULT_QUANTIZATION_BITS);
+
+    // a pure point set
+    const vector<Vec3f> points(vertices.begin(), vertices.begin() + 50);
+    CHECK(MeshCodec::encode(points, {}, buffer));
+    checkRoundTrip(points, {}, buffer, MeshCodec::DEFAULT_QUANTIZATION_BITS);
+}
+
+void testChunks()
+{
+    vector<Vec3f> vertices;
+    vector<Vec3i> triangles;
+    makeGrid(60, vertices, triangles);
+    const unsigned int chunkTriangles = 64;
+    vector<unsigned char> buffer;
+    CHECK(MeshCodec::encode(vertices, triangles, buffer, 16, chunkTriangles));
+    checkRoundTrip(vertices, triangles, buffer, 16);
+
+    // neighbouring grid rows end up in different chunks, so later chunks must reference
+    // vertices introduced by earlier ones
+    vector<Vec3f> decodedVertices;
+    vector<Vec3i> decodedTriangles;
+    CHECK(MeshCodec::decode(buffer.data(), buffer.size(), decodedVertices, decodedTriangles));
+    vector<size_t> firstUse(decodedVertices.size(), decodedTriangles.size());
+    size_t crossChunk = 0;
+    for (size_t t = 0; t < decodedTriangles.size(); ++t) {
+        for (unsigned int k = 0; k < 3; ++k) {
+            size_t &first = firstUse[decodedTriangles[t][k]];
+            first = std::min(first, t);
+            crossChunk += first / chunkTriangles < t / chunkTriangles;
+        }
+    }
+    CHECK(crossChunk > 0);
+}
+
+void testCorruption()
+{
+    vector<Vec3f> vertices;
+    vector<Vec3i> triangles;
+    makeGrid(40, vertices, triangles);
+    vector<unsigned char> buffer;
+    CHECK(MeshCodec::encode(vertices, triangles, buffer, 16, 500));
+
+    size_t accepted = 0;
+    for (size_t size = 0; size < buffer.size(); ++size)
+        accepted += !rejects(vector<unsigned char>(buffer.begin(), buffer.begin() + size));
+    CHECK(accepted == 0);
+
+    auto corrupted = buffer;
+    corrupted[0] = 'X';
+    CHECK(rejects(corrupted));
+    corrupted = buffer;
+    corrupted[4] = 99; // unknown version
+    CHECK(rejects(corrupted));
+    corrupted = buffer;
+    corrupted[16] = 0xff; // chunk count beyond the chunk table
+    CHECK(rejects(corrupted));
+    corrupted = buffer;
+    corrupted[48 + 24] ^= 0x10; // payload size of the first chunk
+    CHECK(rejects(corrupted));
+    corrupted = buffer;
+    corrupted.push_back(0); // trailing garbage after the last payload
+    CHECK(rejects(corrupted));
+
+    // flipping any byte of the payloads must never crash the decoder and is
+    // almost always detected by the rANS final state check
+    const uint32_t chunkCount = buffer[16] | (buffer[17] << 8);
+    const size_t payloadBegin = 48 + size_t(chunkCount) * 32;
+    size_t detected = 0, flips = 0;
+    for (size_t i = payloadBegin; i < buffer.size(); i += 7) {
+        corrupted = buffer;
+        corrupted[i] ^= 0x5a;
+        ++flips;
+        detected += rejects(corrupted);
+    }
+    cout << "corruption: " << detected << " of " << flips << " payload byte flips rejected"
+         << endl;
+    CHECK(detected * 10 >= flips * 9);
+}
+
+} // namespace
+
+int main()
+{
+    testGrid();
+    testEmptyMesh();
+    testUnreferencedVertices();
+    testChunks();
+    testCorruption();
+    if (failures > 0) {
+        cout << failures << " checks failed" << endl;
+        return 1;
+    }
+    cout << "all checks passed" << endl;
+    return 0;
+}
@@ -12,12 +12,24 @@
 #include <iostream>
 #include <fstream>
 #include <cfloat>
+#include <climits>
+#include <mutex>
+
+#if defined(__SSE__) || defined(_M_X64)
+#    include <xmmintrin.h>
+#    define TRIANGLEMESH_USE_SSE
+#endif
 
 #include <QtMath>
+#include <QElapsedTimer>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions_2_1>
 
 #include "trianglemesh.h"
+#include "meshcodec.h"
+#include "meshtopology.h"
+#include "morton.h"
+#include "parallel.h"
 
 void TriangleMesh::calculateNormals(bool weightByAngle)
 {
@@ -85,23 +97,30 @@ void TriangleMesh::calculateNormals(bool weightByAngle)
         // erroneous normals
         normal.normalize();
     }
+    markDirty(0, normals.size());
+    ++normalsRevision;
 }
 
 // ================
 // === RAW DATA ===
 // ================
 
+// the caller may change anything through the mutable references, so everything is re-uploaded
+
 vector<TriangleMesh::Vertex> &TriangleMesh::getPoints()
 {
+    invalidateBuffers();
     return vertices;
 }
 vector<TriangleMesh::Triangle> &TriangleMesh::getTriangles()
 {
+    invalidateBuffers();
     return triangles;
 }
 
 vector<TriangleMesh::Normal> &TriangleMesh::getNormals()
 {
+    invalidateBuffers();
     return normals;
 }
 
@@ -120,18 +139,721 @@ const vector<TriangleMesh::Normal> &TriangleMesh::getNormals() const
     return normals;
 }
 
+void TriangleMesh::setColors(vector<Vec3f> newColors)
+{
+    colors.swap(newColors);
+    colorsDirty = true;
+}
+
+namespace {
+
+// edge, area and volume sums over a range of triangles, see TriangleMesh::getStatistics()
+struct TriangleSums
+{
+    double area = 0., volume = 0., edgeSum = 0.;
+    float minEdge = FLT_MAX, maxEdge = 0.f;
+    size_t degenerate = 0;
+};
+
+void accumulateTriangles(const Vec3f *vertices, const Vec3i *triangles, size_t count,
+                         TriangleSums &sums)
+{
+    size_t t = 0;
+#ifdef TRIANGLEMESH_USE_SSE
+    // 4 triangles per step: the corners are gathered into x, y and z registers, all measures
+    // are computed lane-wise. the float lane sums are flushed into the double sums every
+    // FLUSH_STEPS steps to keep the precision of a double accumulation.
+    const size_t FLUSH_STEPS = 256;
+    static const int bitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+    const __m128 eps = _mm_set1_ps(EPS);
+    __m128 minEdge = _mm_set1_ps(sums.minEdge), maxEdge = _mm_set1_ps(sums.maxEdge);
+    const auto laneLength = [](const __m128 v[3]) {
+        return _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(v[0], v[0]), _mm_mul_ps(v[1], v[1])),
+                                      _mm_mul_ps(v[2], v[2])));
+    };
+    const auto laneCross = [](const __m128 a[3], const __m128 b[3], __m128 result[3]) {
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            const unsigned int u = (axis + 1) % 3, w = (axis + 2) % 3;
+            result[axis] = _mm_sub_ps(_mm_mul_ps(a[u], b[w]), _mm_mul_ps(a[w], b[u]));
+        }
+    };
+    const size_t vectorEnd = count & ~size_t(3);
+    while (t < vectorEnd) {
+        const size_t flushEnd = std::min(vectorEnd, t + 4 * FLUSH_STEPS);
+        __m128 area = _mm_setzero_ps(), volume = _mm_setzero_ps(), edgeSum = _mm_setzero_ps();
+        for (; t < flushEnd; t += 4) {
+            const Vec3i *tri = triangles + t;
+            __m128 v[3][3];
+            for (unsigned int k = 0; k < 3; ++k) {
+                const Vec3f &a = vertices[tri[0][k]], &b = vertices[tri[1][k]],
+                            &c = vertices[tri[2][k]], &d = vertices[tri[3][k]];
+                for (unsigned int axis = 0; axis < 3; ++axis)
+                    v[k][axis] = _mm_setr_ps(a[axis], b[axis], c[axis], d[axis]);
+            }
+            __m128 e[3][3];
+            for (unsigned int k = 0; k < 3; ++k) {
+                for (unsigned int axis = 0; axis < 3; ++axis)
+                    e[k][axis] = _mm_sub_ps(v[(k + 1) % 3][axis], v[k][axis]);
+            }
+            const __m128 l0 = laneLength(e[0]), l1 = laneLength(e[1]), l2 = laneLength(e[2]);
+            const __m128 longest = _mm_max_ps(l0, _mm_max_ps(l1, l2));
+            minEdge = _mm_min_ps(minEdge, _mm_min_ps(l0, _mm_min_ps(l1, l2)));
+            maxEdge = _mm_max_ps(maxEdge, longest);
+            edgeSum = _mm_add_ps(edgeSum, _mm_add_ps(l0, _mm_add_ps(l1, l2)));
+
+            // e[2] points from v2 to v0, the normal is (v1 - v0) x (v2 - v0) = e[2] x e[0]
+            __m128 n[3], c12[3];
+            laneCross(e[2], e[0], n);
+            const __m128 doubleArea = laneLength(n);
+            area = _mm_add_ps(area, doubleArea);
+            laneCross(v[1], v[2], c12);
+            volume = _mm_add_ps(volume, _mm_add_ps(_mm_add_ps(_mm_mul_ps(v[0][0], c12[0]),
+                                                              _mm_mul_ps(v[0][1], c12[1])),
+                                                   _mm_mul_ps(v[0][2], c12[2])));
+
+            int degenerate = _mm_movemask_ps(
+                    _mm_cmple_ps(doubleArea, _mm_mul_ps(eps, _mm_mul_ps(longest, longest))));
+            for (unsigned int lane = 0; lane < 4; ++lane) {
+                const Vec3i &r = tri[lane];
+                if (r.x() == r.y() || r.y() == r.z() || r.z() == r.x())
+                    degenerate |= 1 << lane;
+            }
+            sums.degenerate += bitCount[degenerate];
+        }
+        alignas(16) float lanes[3][4];
+        _mm_store_ps(lanes[0], area);
+        _mm_store_ps(lanes[1], volume);
+        _mm_store_ps(lanes[2], edgeSum);
+        for (unsigned int lane = 0; lane < 4; ++lane) {
+            sums.area += 0.5 * lanes[0][lane];
+            sums.volume += lanes[1][lane] / 6.;
+            sums.edgeSum += lanes[2][lane];
+        }
+    }
+    alignas(16) float lanes[2][4];
+    _mm_store_ps(lanes[0], minEdge);
+    _mm_store_ps(lanes[1], maxEdge);
+    for (unsigned int lane = 0; lane < 4; ++lane) {
+        sums.minEdge = std::min(sums.minEdge, lanes[0][lane]);
+        sums.maxEdge = std::max(sums.maxEdge, lanes[1][lane]);
+    }
+#endif
+    for (; t < count; ++t) {
+        const Vec3i &tri = triangles[t];
+        const Vec3f &v0 = vertices[tri.x()];
+        const Vec3f &v1 = vertices[tri.y()];
+        const Vec3f &v2 = vertices[tri.z()];
+        const float l0 = (v1 - v0).length(), l1 = (v2 - v1).length(), l2 = (v0 - v2).length();
+        const float longest = std::max(l0, std::max(l1, l2));
+        sums.minEdge = std::min(sums.minEdge, std::min(l0, std::min(l1, l2)));
+        sums.maxEdge = std::max(sums.maxEdge, longest);
+        sums.edgeSum += double(l0) + l1 + l2;
+
+        const Vec3f n = cross(v1 - v0, v2 - v0);
+        const float doubleArea = n.length();
+        sums.area += 0.5 * doubleArea;
+        sums.volume += (v0 * cross(v1, v2)) / 6.;
+        if (tri.x() == tri.y() || tri.y() == tri.z() || tri.z() == tri.x()
+            || doubleArea <= EPS * longest * longest)
+            ++sums.degenerate;
+    }
+}
+
+} // namespace
+
+const MeshStatistics &TriangleMesh::getStatistics() const
+{
+    if (statisticsValid)
+        return statistics;
+
+    // vertices and triangles are walked in the same parallel loop: every block of the loop covers
+    // the same fraction of both arrays. the blocks reduce with SSE, their results are merged once
+    // per block.
+    const size_t vertexCount = vertices.size();
+    const size_t triangleCount = triangles.size();
+    const size_t units = std::max(vertexCount, triangleCount);
+    MeshStatistics result;
+    result.bboxMin = Vec3f(FLT_MAX);
+    result.bboxMax = Vec3f(-FLT_MAX);
+    result.minEdgeLength = FLT_MAX;
+    std::mutex resultMutex;
+    parallelFor(0, units, [&](size_t first, size_t last) {
+        Vec3f bboxMin(FLT_MAX), bboxMax(-FLT_MAX);
+        const size_t firstVertex = first * vertexCount / units;
+        extendBounds(vertices.data() + firstVertex, last * vertexCount / units - firstVertex,
+                     bboxMin, bboxMax);
+        TriangleSums sums;
+        const size_t firstTriangle = first * triangleCount / units;
+        accumulateTriangles(vertices.data(), triangles.data() + firstTriangle,
+                            last * triangleCount / units - firstTriangle, sums);
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            result.bboxMin[axis] = std::min(result.bboxMin[axis], bboxMin[axis]);
+            result.bboxMax[axis] = std::max(result.bboxMax[axis], bboxMax[axis]);
+        }
+        result.surfaceArea += sums.area;
+        result.volume += sums.volume;
+        result.meanEdgeLength += sums.edgeSum;
+        result.minEdgeLength = std::min(result.minEdgeLength, sums.minEdge);
+        result.maxEdgeLength = std::max(result.maxEdgeLength, sums.maxEdge);
+        result.degenerateTriangles += sums.degenerate;
+    }, 1 << 15);
+
+    if (vertexCount == 0)
+        result.bboxMin = result.bboxMax = Vec3f(0.f);
+    if (triangleCount == 0)
+        result.minEdgeLength = 0.f;
+    else
+        result.meanEdgeLength /= 3. * triangleCount;
+
+    statistics = result;
+    statisticsValid = true;
+    return statistics;
+}
+
+const uint32_t TriangleMesh::CLUSTER_TRIANGLES;
+const size_t TriangleMesh::MAX_SWEEP_TRIANGULATION_POINTS;
+
+const vector<MeshCluster> &TriangleMesh::getClusters() const
+{
+    if (clustersRevision != revision)
+        buildClusters();
+    return clusters;
+}
+
+const vector<TriangleMesh::Triangle> &TriangleMesh::getClusterTriangles() const
+{
+    if (clustersRevision != revision)
+        buildClusters();
+    return clusterTriangles;
+}
+
+void TriangleMesh::buildClusters() const
+{
+    clustersRevision = revision;
+    clusters.clear();
+    clusterTriangles.clear();
+    const size_t count = triangles.size();
+    if (count == 0 || count > UINT32_MAX)
+        return;
+
+    // sort the triangles along a Morton curve through their centroids
+    const MeshStatistics &stats = getStatistics();
+    const Vec3f extent = stats.bboxMax - stats.bboxMin;
+    const float size = std::max(std::max(extent.x(), extent.y()), std::max(extent.z(), EPS));
+    const float scale = ((1u << MORTON_BITS) - 1) / size;
+    vector<pair<uint64_t, uint32_t>> keys(count);
+    parallelFor(0, count, [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; ++t) {
+            const Triangle &tri = triangles[t];
+            const Vec3f centroid = (vertices[tri[0]] + vertices[tri[1]] + vertices[tri[2]]) / 3.f;
+            keys[t] = make_pair(mortonCode(centroid, stats.bboxMin, scale),
+                                static_cast<uint32_t>(t));
+        }
+    });
+    parallelSort(keys, [](const pair<uint64_t, uint32_t> &a, const pair<uint64_t, uint32_t> &b) {
+        return a.first < b.first;
+    });
+
+    // consecutive runs of the sorted triangles form the clusters
+    clusterTriangles.resize(count);
+    clusters.resize((count + CLUSTER_TRIANGLES - 1) / CLUSTER_TRIANGLES);
+    parallelFor(
+            0, clusters.size(),
+            [&](size_t first, size_t last) {
+                for (size_t c = first; c < last; ++c) {
+                    MeshCluster &cluster = clusters[c];
+                    cluster.first = static_cast<uint32_t>(c * CLUSTER_TRIANGLES);
+                    cluster.count = static_cast<uint32_t>(
+                            std::min<size_t>(CLUSTER_TRIANGLES, count - cluster.first));
+                    cluster.bboxMin = Vec3f(FLT_MAX);
+                    cluster.bboxMax = Vec3f(-FLT_MAX);
+                    for (uint32_t i = cluster.first; i < cluster.first + cluster.count; ++i) {
+                        const Triangle &tri = triangles[keys[i].second];
+                        clusterTriangles[i] = tri;
+                        for (unsigned int k = 0; k < 3; ++k) {
+                            for (unsigned int axis = 0; axis < 3; ++axis) {
+                                cluster.bboxMin[axis] =
+                                        std::min(cluster.bboxMin[axis], vertices[tri[k]][axis]);
+                                cluster.bboxMax[axis] =
+                                        std::max(cluster.bboxMax[axis], vertices[tri[k]][axis]);
+                            }
+                        }
+                    }
+                }
+            },
+            16);
+}
+
 void TriangleMesh::flipNormals()
 {
     for (auto &normal : normals) {
         normal *= -1.0;
     }
+    markDirty(0, normals.size());
+    ++normalsRevision;
+}
+
+void TriangleMesh::transform(const Mat4f &m)
+{
+    const Mat3f normalMatrix = m.upperLeft().normalMatrix();
+    const bool hasNormals = normals.size() == vertices.size();
+    parallelFor(0, vertices.size(), [&](size_t first, size_t last) {
+        transformPoints(m, vertices.data() + first, vertices.data() + first, last - first);
+        if (hasNormals)
+            transformDirections(normalMatrix, normals.data() + first, normals.data() + first,
+                                last - first, true);
+    }, 1 << 16);
+    markDirty(0, vertices.size());
+    invalidateStatistics();
+    ++normalsRevision;
+}
+
+void TriangleMesh::appendInstance(const TriangleMesh &instance, const Mat4f &m)
+{
+    // instance may be this mesh, so all sizes are taken before resizing. the source ranges stay
+    // in front of the appended ones.
+    const size_t vertexOffset = vertices.size();
+    const size_t triangleOffset = triangles.size();
+    const size_t count = instance.vertices.size();
+    const size_t triangleCount = instance.triangles.size();
+    const bool hasNormals = normals.size() == vertices.size()
+            && instance.normals.size() == instance.vertices.size();
+    vertices.resize(vertexOffset + count);
+    if (hasNormals)
+        normals.resize(vertexOffset + count);
+    triangles.resize(triangleOffset + triangleCount);
+
+    const Mat3f normalMatrix = m.upperLeft().normalMatrix();
+    parallelFor(0, count, [&](size_t first, size_t last) {
+        transformPoints(m, instance.vertices.data() + first, vertices.data() + vertexOffset + first,
+                        last - first);
+        if (hasNormals)
+            transformDirections(normalMatrix, instance.normals.data() + first,
+                                normals.data() + vertexOffset + first, last - first, true);
+    }, 1 << 16);
+    const Triangle offset(static_cast<int>(vertexOffset));
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangles[triangleOffset + t] = instance.triangles[t] + offset;
+
+    if (!hasNormals)
+        calculateNormals();
+    invalidateBuffers();
+}
+
+void TriangleMesh::smooth(unsigned int iterations, bool cotangentWeights, float lambda, float mu)
+{
+    const size_t count = vertices.size();
+    if (iterations == 0 || count == 0)
+        return;
+    const VertexNeighbors rings = VertexNeighbors::build(vertices, triangles, cotangentWeights);
+
+    // double buffered positions padded to x, y, z, 0: a neighbor is fetched with a single SSE
+    // load instead of three scattered ones
+    vector<float> current(4 * count), next(4 * count);
+    parallelFor(0, count, [&](size_t first, size_t last) {
+        for (size_t v = first; v < last; ++v) {
+            for (unsigned int axis = 0; axis < 3; ++axis)
+                current[4 * v + axis] = vertices[v][axis];
+        }
+    });
+
+    const uint32_t *neighbors = rings.neighbors.data();
+    const float *weights = cotangentWeights ? rings.weights.data() : nullptr;
+    const auto step = [&](float factor) {
+        parallelFor(0, count, [&](size_t first, size_t last) {
+            const float *in = current.data();
+            float *out = next.data();
+            for (size_t v = first; v < last; ++v) {
+                const uint32_t begin = rings.begin(v), end = rings.end(v);
+#ifdef TRIANGLEMESH_USE_SSE
+                // two accumulators hide the latency of the additions
+                __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+                float weightSum = 0.f;
+                uint32_t n = begin;
+                if (weights) {
+                    for (; n + 1 < end; n += 2) {
+                        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_set1_ps(weights[n]),
+                                                           _mm_loadu_ps(in + 4 * neighbors[n])));
+                        sum1 = _mm_add_ps(sum1,
+                                          _mm_mul_ps(_mm_set1_ps(weights[n + 1]),
+                                                     _mm_loadu_ps(in + 4 * neighbors[n + 1])));
+                        weightSum += weights[n] + weights[n + 1];
+                    }
+                    if (n < end) {
+                        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_set1_ps(weights[n]),
+                                                           _mm_loadu_ps(in + 4 * neighbors[n])));
+                        weightSum += weights[n];
+                    }
+                } else {
+                    for (; n + 1 < end; n += 2) {
+                        sum0 = _mm_add_ps(sum0, _mm_loadu_ps(in + 4 * neighbors[n]));
+                        sum1 = _mm_add_ps(sum1, _mm_loadu_ps(in + 4 * neighbors[n + 1]));
+                    }
+                    if (n < end)
+                        sum0 = _mm_add_ps(sum0, _mm_loadu_ps(in + 4 * neighbors[n]));
+                    weightSum = static_cast<float>(end - begin);
+                }
+                const float t = (rings.boundary[v] || weightSum <= 0.f) ? 0.f : factor;
+                const float inv = weightSum > 0.f ? 1.f / weightSum : 0.f;
+                const __m128 p = _mm_loadu_ps(in + 4 * v);
+                const __m128 average = _mm_mul_ps(_mm_add_ps(sum0, sum1), _mm_set1_ps(inv));
+                _mm_storeu_ps(out + 4 * v,
+                              _mm_add_ps(p, _mm_mul_ps(_mm_set1_ps(t), _mm_sub_ps(average, p))));
+#else
+                float sum[3] = { 0.f, 0.f, 0.f }, weightSum = 0.f;
+                for (uint32_t n = begin; n < end; ++n) {
+                    const float w = weights ? weights[n] : 1.f;
+                    const float *q = in + 4 * neighbors[n];
+                    for (unsigned int axis = 0; axis < 3; ++axis)
+                        sum[axis] += w * q[axis];
+                    weightSum += w;
+                }
+                const float t = (rings.boundary[v] || weightSum <= 0.f) ? 0.f : factor;
+                const float inv = weightSum > 0.f ? 1.f / weightSum : 0.f;
+                for (unsigned int axis = 0; axis < 3; ++axis) {
+                    const float p = in[4 * v + axis];
+                    out[4 * v + axis] = p + t * (sum[axis] * inv - p);
+                }
+#endif
+            }
+        });
+        current.swap(next);
+    };
+    for (unsigned int i = 0; i < iterations; ++i) {
+        step(lambda);
+        if (mu != 0.f)
+            step(mu);
+    }
+
+    parallelFor(0, count, [&](size_t first, size_t last) {
+        for (size_t v = first; v < last; ++v)
+            vertices[v] = Vertex(current[4 * v], current[4 * v + 1], current[4 * v + 2]);
+    });
+    invalidateStatistics();
+    calculateNormals();
+}
+
+vector<SubdivisionLevel> TriangleMesh::subdivideLoop(unsigned int levels,
+                                                     const AdaptiveSubdivision *adaptive)
+{
+    vector<SubdivisionLevel> timings;
+    for (unsigned int level = 0; level < levels && !triangles.empty(); ++level) {
+        QElapsedTimer timer;
+        timer.start();
+        const size_t vertexCount = vertices.size();
+        const size_t triangleCount = triangles.size();
+        if (vertexCount + 3 * triangleCount > size_t(INT_MAX)) {
+            cout << "subdivideLoop: mesh too large for another level" << endl;
+            return timings;
+        }
+        if (adaptive && adaptive->curvatureAngle > 0.f && normals.size() != vertexCount)
+            calculateNormals();
+
+        // edge map: the half edges keyed by their sorted vertex pair, after sorting the half edges
+        // of one edge are neighbors. edge e consists of halfEdges[edgeFirst[e] .. edgeFirst[e+1])
+        typedef pair<uint64_t, uint32_t> HalfEdge;
+        vector<HalfEdge> halfEdges(3 * triangleCount);
+        parallelFor(0, triangleCount, [&](size_t first, size_t last) {
+            for (size_t t = first; t < last; ++t) {
+                for (unsigned int k = 0; k < 3; ++k) {
+                    const uint32_t a = triangles[t][k], b = triangles[t][(k + 1) % 3];
+                    halfEdges[3 * t + k] = make_pair(
+                            (uint64_t(std::min(a, b)) << 32) | std::max(a, b), uint32_t(3 * t + k));
+                }
+            }
+        });
+        parallelSort(halfEdges,
+                     [](const HalfEdge &a, const HalfEdge &b) { return a.first < b.first; });
+        vector<uint32_t> edgeFirst;
+        edgeFirst.reserve(halfEdges.size() / 2 + 1);
+        for (size_t i = 0; i < halfEdges.size(); ++i) {
+            if (i == 0 || halfEdges[i].first != halfEdges[i - 1].first)
+                edgeFirst.push_back(static_cast<uint32_t>(i));
+        }
+        const size_t edgeCount = edgeFirst.size();
+        edgeFirst.push_back(static_cast<uint32_t>(halfEdges.size()));
+        vector<uint32_t> triangleEdges(3 * triangleCount);
+        parallelFor(0, edgeCount, [&](size_t first, size_t last) {
+            for (size_t e = first; e < last; ++e) {
+                for (uint32_t h = edgeFirst[e]; h < edgeFirst[e + 1]; ++h)
+                    triangleEdges[halfEdges[h].second] = static_cast<uint32_t>(e);
+            }
+        });
+
+        // triangles selected for refinement
+        vector<unsigned char> selected(triangleCount, 1);
+        if (adaptive) {
+            const float minCosine = std::cos(adaptive->curvatureAngle * M_RadToDeg);
+            const float halfWidth = 0.5f * adaptive->viewportWidth;
+            const float halfHeight = 0.5f * adaptive->viewportHeight;
+            parallelFor(0, triangleCount, [&](size_t first, size_t last) {
+                for (size_t t = first; t < last; ++t) {
+                    const Triangle &tri = triangles[t];
+                    bool refine = false;
+                    if (adaptive->curvatureAngle > 0.f) {
+                        for (unsigned int k = 0; k < 3 && !refine; ++k)
+                            refine = normals[tri[k]] * normals[tri[(k + 1) % 3]] < minCosine;
+                    }
+                    if (adaptive->maxScreenEdge > 0.f && !refine) {
+                        // edges of triangles reaching behind the camera are not measured
+                        float screen[3][2];
+                        bool inFront = true;
+                        for (unsigned int k = 0; k < 3; ++k) {
+                            float clip[4];
+                            adaptive->modelViewProjection.transformPoint(vertices[tri[k]], clip);
+                            inFront &= clip[3] > EPS;
+                            screen[k][0] = clip[0] / clip[3] * halfWidth;
+                            screen[k][1] = clip[1] / clip[3] * halfHeight;
+                        }
+                        const float maxSquared = adaptive->maxScreenEdge * adaptive->maxScreenEdge;
+                        for (unsigned int k = 0; k < 3 && inFront && !refine; ++k) {
+                            const float dx = screen[k][0] - screen[(k + 1) % 3][0];
+                            const float dy = screen[k][1] - screen[(k + 1) % 3][1];
+                            refine = dx * dx + dy * dy > maxSquared;
+                        }
+                    }
+                    selected[t] = refine;
+                }
+            });
+        }
+
+        // an edge is split if one of its triangles is selected. the new vertices are appended
+        // behind the old ones in edge order.
+        vector<int> edgeVertex(edgeCount, -1);
+        parallelFor(0, edgeCount, [&](size_t first, size_t last) {
+            for (size_t e = first; e < last; ++e) {
+                for (uint32_t h = edgeFirst[e]; h < edgeFirst[e + 1]; ++h) {
+                    if (selected[halfEdges[h].second / 3])
+                        edgeVertex[e] = 0;
+                }
+            }
+        });
+        size_t splitCount = 0;
+        for (auto &index : edgeVertex) {
+            if (index == 0)
+                index = static_cast<int>(vertexCount + splitCount++);
+        }
+        if (splitCount == 0)
+            break;
+
+        // per vertex: neighbors along boundary edges, and whether an incident edge stays unsplit
+        // or is non-manifold. such vertices keep their position.
+        vector<Vec3f> boundarySum(vertexCount, Vec3f(0.f));
+        vector<unsigned char> boundaryCount(vertexCount, 0), fixed(vertexCount, 0);
+        for (size_t e = 0; e < edgeCount; ++e) {
+            const uint32_t a = static_cast<uint32_t>(halfEdges[edgeFirst[e]].first >> 32);
+            const uint32_t b = static_cast<uint32_t>(halfEdges[edgeFirst[e]].first);
+            const uint32_t sides = edgeFirst[e + 1] - edgeFirst[e];
+            if (edgeVertex[e] < 0 || sides > 2) {
+                fixed[a] = fixed[b] = 1;
+            } else if (sides == 1) {
+                boundarySum[a] += vertices[b];
+                boundarySum[b] += vertices[a];
+                boundaryCount[a] = std::min(boundaryCount[a] + 1, 255);
+                boundaryCount[b] = std::min(boundaryCount[b] + 1, 255);
+            }
+        }
+
+        vector<Vertex> newVertices(vertexCount + splitCount);
+        const VertexNeighbors rings = VertexNeighbors::build(vertices, triangles);
+        // even vertices: weighted with their one-ring, boundary vertices with the two boundary
+        // neighbors only
+        parallelFor(0, vertexCount, [&](size_t first, size_t last) {
+            for (size_t v = first; v < last; ++v) {
+                const uint32_t valence = rings.valence(v);
+                if (fixed[v] || valence == 0) {
+                    newVertices[v] = vertices[v];
+                } else if (rings.boundary[v]) {
+                    newVertices[v] = boundaryCount[v] == 2
+                            ? vertices[v] * 0.75f + boundarySum[v] * 0.125f
+                            : vertices[v];
+                } else {
+                    const float c = 0.375f + 0.25f * std::cos(2.f * float(M_PI) / valence);
+                    const float beta = (0.625f - c * c) / valence;
+                    Vec3f sum(0.f);
+                    for (uint32_t n = rings.begin(v); n < rings.end(v); ++n)
+                        sum += vertices[rings.neighbors[n]];
+                    newVertices[v] = vertices[v] * (1.f - valence * beta) + sum * beta;
+                }
+            }
+        });
+        // odd vertices: 3/8 of the edge end points and 1/8 of the two opposite vertices,
+        // the midpoint on boundary and non-manifold edges
+        parallelFor(0, edgeCount, [&](size_t first, size_t last) {
+            for (size_t e = first; e < last; ++e) {
+                if (edgeVertex[e] < 0)
+                    continue;
+                const uint32_t h0 = halfEdges[edgeFirst[e]].second;
+                const Triangle &t0 = triangles[h0 / 3];
+                const Vec3f &a = vertices[t0[h0 % 3]], &b = vertices[t0[(h0 + 1) % 3]];
+                Vertex &out = newVertices[edgeVertex[e]];
+                if (edgeFirst[e + 1] - edgeFirst[e] == 2) {
+                    const uint32_t h1 = halfEdges[edgeFirst[e] + 1].second;
+                    const Vec3f &c = vertices[t0[(h0 + 2) % 3]];
+                    const Vec3f &d = vertices[triangles[h1 / 3][(h1 + 2) % 3]];
+                    out = (a + b) * 0.375f + (c + d) * 0.125f;
+                } else {
+                    out = (a + b) * 0.5f;
+                }
+            }
+        });
+
+        // faces: 4 children for three split edges, 3 for two, 2 for one (conforming split)
+        vector<uint32_t> faceOffsets(triangleCount + 1, 0);
+        parallelFor(0, triangleCount, [&](size_t first, size_t last) {
+            for (size_t t = first; t < last; ++t) {
+                uint32_t children = 1;
+                for (unsigned int k = 0; k < 3; ++k)
+                    children += edgeVertex[triangleEdges[3 * t + k]] >= 0;
+                faceOffsets[t + 1] = children;
+            }
+        });
+        for (size_t t = 0; t < triangleCount; ++t)
+            faceOffsets[t + 1] += faceOffsets[t];
+        vector<Triangle> newTriangles(faceOffsets.back());
+        parallelFor(0, triangleCount, [&](size_t first, size_t last) {
+            for (size_t t = first; t < last; ++t) {
+                const Triangle &tri = triangles[t];
+                // m[k] is the new vertex on the edge from corner k to corner k + 1
+                int m[3];
+                unsigned int splitEdges = 0, unsplit = 0, split = 0;
+                for (unsigned int k = 0; k < 3; ++k) {
+                    m[k] = edgeVertex[triangleEdges[3 * t + k]];
+                    if (m[k] >= 0) {
+                        ++splitEdges;
+                        split = k;
+                    } else {
+                        unsplit = k;
+                    }
+                }
+                Triangle *out = newTriangles.data() + faceOffsets[t];
+                const auto corner = [&](unsigned int k) { return tri[k % 3]; };
+                if (splitEdges == 0) {
+                    out[0] = tri;
+                } else if (splitEdges == 1) {
+                    out[0] = Triangle(corner(split), m[split], corner(split + 2));
+                    out[1] = Triangle(m[split], corner(split + 1), corner(split + 2));
+                } else if (splitEdges == 2) {
+                    const int p = corner(unsplit), q = corner(unsplit + 1), r = corner(unsplit + 2);
+                    const int qr = m[(unsplit + 1) % 3], rp = m[(unsplit + 2) % 3];
+                    out[0] = Triangle(qr, r, rp);
+                    out[1] = Triangle(p, q, qr);
+                    out[2] = Triangle(p, qr, rp);
+                } else {
+                    out[0] = Triangle(tri[0], m[0], m[2]);
+                    out[1] = Triangle(tri[1], m[1], m[0]);
+                    out[2] = Triangle(tri[2], m[2], m[1]);
+                    out[3] = Triangle(m[0], m[1], m[2]);
+                }
+            }
+        });
+
+        vertices.swap(newVertices);
+        triangles.swap(newTriangles);
+        invalidateBuffers();
+        calculateNormals();
+        SubdivisionLevel done;
+        done.trianglesBefore = triangleCount;
+        done.trianglesAfter = triangles.size();
+        done.milliseconds = timer.elapsed();
+        timings.push_back(done);
+    }
+    return timings;
+}
+
+void TriangleMesh::invalidateBuffers()
+{
+    invalidateStatistics();
+    ++normalsRevision;
+    buffersDirty = true;
+    dirtyRanges.clear();
+}
+
+void TriangleMesh::markDirty(size_t first, size_t last)
+{
+    if (buffersDirty || first >= last)
+        return;
+    // merge with the previous range if they (nearly) touch to keep the number of uploads low
+    const size_t mergeGap = 256;
+    if (!dirtyRanges.empty() && first <= dirtyRanges.back().second + mergeGap
+        && last + mergeGap >= dirtyRanges.back().first) {
+        dirtyRanges.back().first = std::min(dirtyRanges.back().first, first);
+        dirtyRanges.back().second = std::max(dirtyRanges.back().second, last);
+    } else {
+        dirtyRanges.emplace_back(first, last);
+    }
+}
+
+MeshSnapshot TriangleMesh::snapshot() const
+{
+    MeshSnapshot copy;
+    copy.vertices = vertices;
+    copy.normals = normals;
+    copy.triangles = triangles;
+    copy.revision = revision;
+    copy.normalsRevision = normalsRevision;
+    return copy;
+}
+
+MeshReloadDiff TriangleMesh::diffReload(const MeshSnapshot &previous) const
+{
+    MeshReloadDiff diff;
+    diff.revision = previous.revision;
+    diff.normalsRevision = previous.normalsRevision;
+    diff.topologyKept = vertices.size() == previous.vertices.size()
+            && normals.size() == previous.normals.size() && triangles == previous.triangles;
+    if (!diff.topologyKept)
+        return diff;
+
+    // same topology: find the ranges of moved vertices or changed normals
+    size_t i = 0;
+    while (i < vertices.size()) {
+        if (vertices[i] == previous.vertices[i] && normals[i] == previous.normals[i]) {
+            ++i;
+            continue;
+        }
+        const size_t first = i;
+        while (i < vertices.size()
+               && (vertices[i] != previous.vertices[i] || normals[i] != previous.normals[i])) {
+            diff.positionsChanged |= vertices[i] != previous.vertices[i];
+            diff.normalsChanged |= normals[i] != previous.normals[i];
+            ++i;
+        }
+        diff.ranges.emplace_back(first, i);
+    }
+    return diff;
+}
+
+bool TriangleMesh::reloadFrom(TriangleMesh &other, const MeshReloadDiff &diff)
+{
+    if (!diff.topologyKept || diff.revision != revision
+        || diff.normalsRevision != normalsRevision) {
+        vertices.swap(other.vertices);
+        normals.swap(other.normals);
+        triangles.swap(other.triangles);
+        invalidateBuffers();
+        return false;
+    }
+
+    for (const auto &range : diff.ranges)
+        markDirty(range.first, range.second);
+    vertices.swap(other.vertices);
+    normals.swap(other.normals);
+    // a reload that only rewrote normals keeps the statistics and clusters
+    if (diff.positionsChanged)
+        invalidateStatistics();
+    if (diff.normalsChanged)
+        ++normalsRevision;
+    return true;
 }
 
 // =================
 // === LOAD MESH ===
 // =================
 
-void TriangleMesh::loadLSA(const char *filename)
+void TriangleMesh::loadLSA(const char *filename, bool triangulate, float maxEdgeFactor)
 {
     const constexpr auto DEG_TO_RAD = M_PI / 180.;
 
@@ -144,6 +866,8 @@ void TriangleMesh::loadLSA(const char *filename)
     float baseline = -1.0; // Initial baseline with invalid value. Needs to be updated when reading the file.
     vertices.resize(0);
     triangles.resize(0);
+    invalidateBuffers();
+    vector<float> alphas, betas;
     // read vertices and triangles
     // TODO: 2) read alpha, beta, gamma for each vertex and calculate vertex coordinates
     // TODO: 2) read all triangles from the file
@@ -152,35 +876,156 @@ void TriangleMesh::loadLSA(const char *filename)
     while (std::getline(in, line)) {
         if (line.empty() || line[0] == '#')
             continue;
-    }
-    char type;
-    float a, b, g;
-    if (line[0] == 'b') {
-        sscanf(line.c_str(), "b %f", &baseline);
-    }
-    if (line[0] == 'v') {
-        sscanf(line.c_str(), "v %f %f %f", &a, &b, &g);
-        //convert deg to rad
-        float alpha = a * DEG_TO_RAD;
-        float beta = b * DEG_TO_RAD;
-        float gamma = g * DEG_TO_RAD;
+        float a, b, g;
+        if (line[0] == 'b') {
+            sscanf(line.c_str(), "b %f", &baseline);
+        }
+        if (line[0] == 'v') {
+            sscanf(line.c_str(), "v %f %f %f", &a, &b, &g);
+            //convert deg to rad
+            float alpha = a * DEG_TO_RAD;
+            float beta = b * DEG_TO_RAD;
+            float gamma = g * DEG_TO_RAD;
 
-        //calculate the angle to coordinate
-        float x = baseline + cos(beta) * sin(alpha);
-        float y = sin(gamma);
-        float z = -cos(beta) * cos(alpha);
+            //calculate the angle to coordinate
+            float x = baseline + cos(beta) * sin(alpha);
+            float y = sin(gamma);
+            float z = -cos(beta) * cos(alpha);
 
-        vertices.emplace_back(x, y, z);
+            vertices.emplace_back(x, y, z);
+            alphas.push_back(a);
+            betas.push_back(b);
+        }
+        if (line[0] == 'f') {
+            int i1, i2, i3;
+            sscanf(line.c_str(), "f %d %d %d", &i1, &i2, &i3);
+            triangles.emplace_back(i1 - 1, i2 - 1, i3 - 1);
+        }
     }
-    if (line[0] == 'f') {
-        int i1, i2, i3;
-        sscanf(line.c_str(), "f %d %d %d", &i1, &i2, &i3);
-        triangles.emplace_back(i1 - 1, i2 - 1, i3 - 1);
+    if (triangles.empty() && triangulate) {
+        if (vertices.size() <= MAX_SWEEP_TRIANGULATION_POINTS)
+            triangulateSweeps(alphas, betas, maxEdgeFactor);
+        else
+            cout << "loadLSA: " << vertices.size() << " points, too many to triangulate" << endl;
     }
     // calculate normals
     calculateNormals();
 }
 
+void TriangleMesh::triangulateSweeps(const vector<float> &alphas, const vector<float> &betas,
+                                     float maxEdgeFactor)
+{
+    // a new sweep starts whenever alpha changes
+    const float alphaTolerance = 1e-4f;
+    vector<size_t> sweepStart;
+    for (size_t i = 0; i < alphas.size(); ++i) {
+        if (i == 0 || std::fabs(alphas[i] - alphas[i - 1]) > alphaTolerance)
+            sweepStart.push_back(i);
+    }
+    sweepStart.push_back(alphas.size());
+    const size_t bandCount = sweepStart.size() < 3 ? 0 : sweepStart.size() - 2;
+    if (bandCount == 0)
+        return;
+    // beta may run in either direction, but all sweeps share it
+    const float direction = betas[sweepStart[1] - 1] >= betas[0] ? 1.f : -1.f;
+
+    // zip every pair of neighbouring sweeps along beta, one band per task. the angular sampling
+    // makes edges grow with the distance to the scanner, so the discontinuity test compares the
+    // squared longest edge of every triangle relative to its nearest vertex.
+    vector<Triangles> bands(bandCount);
+    vector<vector<float>> bandEdges(bandCount);
+    parallelFor(
+            0, bandCount,
+            [&](size_t first, size_t last) {
+                for (size_t band = first; band < last; ++band) {
+                    const size_t aEnd = sweepStart[band + 1], bEnd = sweepStart[band + 2];
+                    size_t a = sweepStart[band], b = sweepStart[band + 1];
+                    Triangles &out = bands[band];
+                    vector<float> &edges = bandEdges[band];
+                    out.reserve(bEnd - sweepStart[band]);
+                    edges.reserve(bEnd - sweepStart[band]);
+                    const auto addTriangle = [&](size_t i0, size_t i1, size_t i2) {
+                        const Vertex &v0 = vertices[i0], &v1 = vertices[i1], &v2 = vertices[i2];
+                        out.emplace_back(static_cast<int>(i0), static_cast<int>(i1),
+                                         static_cast<int>(i2));
+                        const float e0 = (v1 - v0).sqlength(), e1 = (v2 - v1).sqlength(),
+                                    e2 = (v0 - v2).sqlength();
+                        const float rangeSq = std::max(
+                                EPS, std::min(v0.sqlength(),
+                                              std::min(v1.sqlength(), v2.sqlength())));
+                        edges.push_back(std::max(e0, std::max(e1, e2)) / rangeSq);
+                    };
+                    while (a + 1 < aEnd || b + 1 < bEnd) {
+                        const bool advanceA = a + 1 < aEnd
+                                && (b + 1 >= bEnd
+                                    || betas[a + 1] * direction <= betas[b + 1] * direction);
+                        if (advanceA) {
+                            addTriangle(a, a + 1, b);
+                            ++a;
+                        } else {
+                            addTriangle(a, b + 1, b);
+                            ++b;
+                        }
+                    }
+                }
+            },
+            16);
+
+    // median relative longest edge, estimated from a sample of all bands
+    vector<float> sample;
+    for (size_t band = 0; band < bandCount; ++band) {
+        const vector<float> &edges = bandEdges[band];
+        const size_t step = std::max<size_t>(1, edges.size() / 64);
+        for (size_t i = 0; i < edges.size(); i += step)
+            sample.push_back(edges[i]);
+    }
+    if (sample.empty())
+        return;
+    std::nth_element(sample.begin(), sample.begin() + sample.size() / 2, sample.end());
+    const float maxEdgeSq = maxEdgeFactor * maxEdgeFactor * sample[sample.size() / 2];
+
+    // drop triangles spanning depth discontinuities and sum up the orientation towards the
+    // scanner in the origin
+    vector<size_t> kept(bandCount + 1, 0);
+    vector<double> facing(bandCount, 0.);
+    parallelFor(
+            0, bandCount,
+            [&](size_t first, size_t last) {
+                for (size_t band = first; band < last; ++band) {
+                    for (size_t t = 0; t < bands[band].size(); ++t) {
+                        if (bandEdges[band][t] > maxEdgeSq)
+                            continue;
+                        const Triangle &tri = bands[band][t];
+                        const Vertex &v0 = vertices[tri.x()];
+                        facing[band] -= cross(vertices[tri.y()] - v0, vertices[tri.z()] - v0) * v0;
+                        ++kept[band + 1];
+                    }
+                }
+            },
+            16);
+    double totalFacing = 0.;
+    for (size_t band = 0; band < bandCount; ++band) {
+        kept[band + 1] += kept[band];
+        totalFacing += facing[band];
+    }
+    const bool flip = totalFacing < 0.;
+
+    triangles.resize(kept.back());
+    parallelFor(
+            0, bandCount,
+            [&](size_t first, size_t last) {
+                for (size_t band = first; band < last; ++band) {
+                    Triangle *out = triangles.data() + kept[band];
+                    for (size_t t = 0; t < bands[band].size(); ++t) {
+                        if (bandEdges[band][t] > maxEdgeSq)
+                            continue;
+                        const Triangle &tri = bands[band][t];
+                        *out++ = flip ? Triangle(tri.x(), tri.z(), tri.y()) : tri;
+                    }
+                }
+            },
+            16);
+}
 
 void TriangleMesh::loadOBJ(const char *filename)
 { 
@@ -192,6 +1037,7 @@ void TriangleMesh::loadOBJ(const char *filename)
 
     vertices.resize(0);
     triangles.resize(0);
+    invalidateBuffers();
 
     // read vertices and triangles
     // 1) read all vertices and triangles from the file
@@ -211,7 +1057,8 @@ void TriangleMesh::loadOBJ(const char *filename)
         } else if (strcmp(lineHeader, "f") == 0) {
             Vec3i triangle;
             fscanf(file, "%d %d %d\n", &triangle.x(), &triangle.y(), &triangle.z());
-            triangles.push_back(triangle);
+            // OBJ indices start at 1
+            triangles.emplace_back(triangle.x() - 1, triangle.y() - 1, triangle.z() - 1);
         }
     }
     fclose(file);
@@ -220,20 +1067,211 @@ void TriangleMesh::loadOBJ(const char *filename)
     calculateNormals();
 }
 
+void TriangleMesh::loadCMSH(const char *filename)
+{
+    std::ifstream in(filename, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) {
+        cout << "loadCMSH: can not open " << filename << endl;
+        return;
+    }
+
+    std::vector<unsigned char> data(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(reinterpret_cast<char *>(data.data()), data.size());
+    invalidateBuffers();
+    if (!in || !MeshCodec::decode(data.data(), data.size(), vertices, triangles)) {
+        cout << "loadCMSH: corrupt file " << filename << endl;
+        vertices.resize(0);
+        triangles.resize(0);
+    }
+
+    // calculate normals
+    calculateNormals();
+}
+
+bool TriangleMesh::saveCMSH(const char *filename, unsigned int quantizationBits) const
+{
+    std::vector<unsigned char> data;
+    if (!MeshCodec::encode(vertices, triangles, data, quantizationBits)) {
+        cout << "saveCMSH: can not encode mesh for " << filename << endl;
+        return false;
+    }
+
+    std::ofstream out(filename, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(data.data()), data.size());
+    if (!out) {
+        cout << "saveCMSH: can not write " << filename << endl;
+        return false;
+    }
+    return true;
+}
+
 // ==============
 // === RENDER ===
 // ==============
 
+size_t TriangleMesh::uploadBuffers(QOpenGLFunctions_2_1 *f)
+{
+    if (vertexBuffer == 0) {
+        f->glGenBuffers(1, &vertexBuffer);
+        f->glGenBuffers(1, &normalBuffer);
+        f->glGenBuffers(1, &indexBuffer);
+        f->glGenBuffers(1, &colorBuffer);
+        buffersDirty = true;
+    }
+
+    const bool hasNormals = normals.size() == vertices.size();
+    size_t bytes = 0;
+    if (buffersDirty) {
+        // topology changed: reallocate all buffers
+        const size_t vertexBytes = vertices.size() * sizeof(Vertex);
+        const size_t normalBytes = hasNormals ? normals.size() * sizeof(Normal) : 0;
+        const size_t indexBytes = triangles.size() * sizeof(Triangle);
+        f->glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        f->glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices.data(), GL_DYNAMIC_DRAW);
+        f->glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+        f->glBufferData(GL_ARRAY_BUFFER, normalBytes, normals.data(), GL_DYNAMIC_DRAW);
+        f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        f->glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, triangles.data(), GL_STATIC_DRAW);
+        f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        bytes = vertexBytes + normalBytes + indexBytes;
+        buffersDirty = false;
+        colorsDirty = true;
+    } else {
+        // only re-upload the changed ranges of positions and normals
+        for (const auto &range : dirtyRanges) {
+            const size_t offset = range.first * sizeof(Vertex);
+            const size_t size = (range.second - range.first) * sizeof(Vertex);
+            f->glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            f->glBufferSubData(GL_ARRAY_BUFFER, offset, size, vertices.data() + range.first);
+            bytes += size;
+            if (hasNormals) {
+                f->glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+                f->glBufferSubData(GL_ARRAY_BUFFER, offset, size, normals.data() + range.first);
+                bytes += size;
+            }
+        }
+    }
+    dirtyRanges.clear();
+    if (colorsDirty) {
+        const size_t colorBytes = colors.size() == vertices.size() ? colors.size() * sizeof(Vec3f)
+                                                                   : 0;
+        f->glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+        f->glBufferData(GL_ARRAY_BUFFER, colorBytes, colors.data(), GL_STATIC_DRAW);
+        bytes += colorBytes;
+        colorsDirty = false;
+    }
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return bytes;
+}
+
+void TriangleMesh::releaseBuffers(QOpenGLFunctions_2_1 *f)
+{
+    if (vertexBuffer == 0)
+        return;
+    f->glDeleteBuffers(1, &vertexBuffer);
+    f->glDeleteBuffers(1, &normalBuffer);
+    f->glDeleteBuffers(1, &indexBuffer);
+    f->glDeleteBuffers(1, &colorBuffer);
+    vertexBuffer = normalBuffer = indexBuffer = colorBuffer = 0;
+    if (clusterIndexBuffer != 0) {
+        f->glDeleteBuffers(1, &clusterIndexBuffer);
+        clusterIndexBuffer = 0;
+        clusterBufferRevision = ~0u;
+    }
+    invalidateBuffers();
+}
+
+void TriangleMesh::drawNormals(DebugLines &lines, float length, const Vec3f &offset) const
+{
+    if (length <= 0.f) {
+        const MeshStatistics &stats = getStatistics();
+        length = 0.02f * (stats.bboxMax - stats.bboxMin).length();
+    }
+    lines.addNormals(vertices, normals, length, Vec3f(0.f, 1.f, 1.f), offset);
+}
+
+void TriangleMesh::bindArrays(QOpenGLFunctions_2_1 *f)
+{
+    f->glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    f->glEnableClientState(GL_VERTEX_ARRAY);
+    f->glVertexPointer(3, GL_FLOAT, 0, nullptr);
+    if (normals.size() == vertices.size()) {
+        f->glBindBuffer(GL_ARRAY_BUFFER, normalBuffer);
+        f->glEnableClientState(GL_NORMAL_ARRAY);
+        f->glNormalPointer(GL_FLOAT, 0, nullptr);
+    }
+    if (colors.size() == vertices.size()) {
+        // with GL_COLOR_MATERIAL the colors scale the ambient and diffuse material
+        f->glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+        f->glEnableClientState(GL_COLOR_ARRAY);
+        f->glColorPointer(3, GL_FLOAT, 0, nullptr);
+    }
+}
+
+void TriangleMesh::unbindArrays(QOpenGLFunctions_2_1 *f)
+{
+    f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    f->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    f->glDisableClientState(GL_COLOR_ARRAY);
+    f->glDisableClientState(GL_NORMAL_ARRAY);
+    f->glDisableClientState(GL_VERTEX_ARRAY);
+}
+
 void TriangleMesh::draw(QOpenGLFunctions_2_1 *f)
 {
     if (triangles.empty())
         return;
 
-    // 3) draw triangles with immediate mode
-    f->glBegin(GL_TRIANGLES);
-    // render objects as white for now 
+    uploadBuffers(f);
+
+    // 3) draw triangles from the vertex buffers
+    // render objects as white for now
     f->glColor3f(1.f, 1.f, 1.f);
-    foreach (Vertex vertex, vertices)
-        f->glVertex3f(vertex.x(), vertex.y(), vertex.z());
-    f->glEnd();
+    bindArrays(f);
+    f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    f->glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(3 * triangles.size()), GL_UNSIGNED_INT,
+                      nullptr);
+    unbindArrays(f);
+}
+
+void TriangleMesh::drawClusters(QOpenGLFunctions_2_1 *f, const vector<unsigned char> &visible)
+{
+    const vector<MeshCluster> &meshClusters = getClusters();
+    if (visible.size() != meshClusters.size()) {
+        draw(f);
+        return;
+    }
+    if (meshClusters.empty())
+        return;
+
+    uploadBuffers(f);
+    if (clusterIndexBuffer == 0)
+        f->glGenBuffers(1, &clusterIndexBuffer);
+    f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, clusterIndexBuffer);
+    if (clusterBufferRevision != clustersRevision) {
+        f->glBufferData(GL_ELEMENT_ARRAY_BUFFER, clusterTriangles.size() * sizeof(Triangle),
+                        clusterTriangles.data(), GL_STATIC_DRAW);
+        clusterBufferRevision = clustersRevision;
+    }
+
+    f->glColor3f(1.f, 1.f, 1.f);
+    bindArrays(f);
+    f->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, clusterIndexBuffer);
+    for (size_t c = 0; c < meshClusters.size();) {
+        if (!visible[c]) {
+            ++c;
+            continue;
+        }
+        size_t end = c + 1;
+        while (end < meshClusters.size() && visible[end])
+            ++end;
+        const size_t first = meshClusters[c].first;
+        const size_t last = meshClusters[end - 1].first + meshClusters[end - 1].count;
+        const void *offset = reinterpret_cast<const void *>(first * sizeof(Triangle));
+        f->glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(3 * (last - first)),
+                          GL_UNSIGNED_INT, offset);
+        c = end;
+    }
+    unbindArrays(f);
 }
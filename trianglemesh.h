@@ -13,14 +13,87 @@
 #define TRIANGLEMESH_H
 
 #include <array>
+#include <utility>
 #include <vector>
 
 #include <QOpenGLFunctions_2_1>
 
+#include "debuglines.h"
+#include "matrix.h"
 #include "vec3.h"
 
 using namespace std;
 
+// analytics of a mesh, see TriangleMesh::getStatistics()
+struct MeshStatistics
+{
+    Vec3f bboxMin, bboxMax;
+    double surfaceArea = 0.;
+    // signed volume, only meaningful for closed meshes
+    double volume = 0.;
+    // over all triangle edges, edges shared by two triangles are counted twice
+    float minEdgeLength = 0.f;
+    float maxEdgeLength = 0.f;
+    double meanEdgeLength = 0.;
+    // triangles with repeated indices or (nearly) zero area
+    size_t degenerateTriangles = 0;
+};
+
+// a spatially coherent run of triangles, see TriangleMesh::getClusters()
+struct MeshCluster
+{
+    Vec3f bboxMin, bboxMax;
+    // range in TriangleMesh::getClusterTriangles()
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+// optional criteria for TriangleMesh::subdivideLoop(). a triangle is refined if any enabled
+// criterion selects it, its neighbors are split conformingly.
+struct AdaptiveSubdivision
+{
+    // refine triangles whose vertex normals enclose an angle larger than this (degree).
+    // <= 0 disables the criterion.
+    float curvatureAngle = 0.f;
+    // refine triangles with an edge longer than this many pixels after projection with
+    // modelViewProjection into a viewport of the given size. <= 0 disables the criterion.
+    float maxScreenEdge = 0.f;
+    Mat4f modelViewProjection;
+    int viewportWidth = 0;
+    int viewportHeight = 0;
+};
+
+// result of one level of TriangleMesh::subdivideLoop()
+struct SubdivisionLevel
+{
+    size_t trianglesBefore = 0;
+    size_t trianglesAfter = 0;
+    long long milliseconds = 0;
+};
+
+// copy of the data of a mesh that a reload is compared against, see TriangleMesh::snapshot()
+struct MeshSnapshot
+{
+    vector<Vec3f> vertices;
+    vector<Vec3f> normals;
+    vector<Vec3i> triangles;
+    unsigned int revision = 0;
+    unsigned int normalsRevision = 0;
+};
+
+// changes of a reloaded mesh against a snapshot, see TriangleMesh::diffReload()
+struct MeshReloadDiff
+{
+    // revisions of the snapshot, the ranges are only valid while the mesh is still at them
+    unsigned int revision = 0;
+    unsigned int normalsRevision = 0;
+    bool topologyKept = false;
+    bool positionsChanged = false;
+    bool normalsChanged = false;
+    // vertex ranges [first, last) whose position or normal changed
+    vector<pair<size_t, size_t>> ranges;
+};
+
 class TriangleMesh
 {
 
@@ -37,8 +110,60 @@ private:
     Vertices vertices;
     Normals normals;
     Triangles triangles;
+    // optional per vertex colors, e.g. baked ambient occlusion
+    vector<Vec3f> colors;
+
+    // GPU buffers and the vertex ranges [first, last) that changed since the last upload
+    GLuint vertexBuffer = 0;
+    GLuint normalBuffer = 0;
+    GLuint indexBuffer = 0;
+    GLuint colorBuffer = 0;
+    bool buffersDirty = true;
+    bool colorsDirty = true;
+    vector<pair<size_t, size_t>> dirtyRanges;
+
+    void invalidateBuffers();
+    // queue a vertex range for upload, the caller updates the revisions
+    void markDirty(size_t first, size_t last);
+
+    // cached analytics, recomputed on the next getStatistics() after a change
+    mutable MeshStatistics statistics;
+    mutable bool statisticsValid = false;
+
+    void invalidateStatistics()
+    {
+        statisticsValid = false;
+        ++revision;
+    }
+
+    // incremented on every change of the vertices or triangles
+    unsigned int revision = 0;
+    // incremented on every change of the normals
+    unsigned int normalsRevision = 0;
+
+    // triangles in Morton order of their centroids, cut into clusters. rebuilt on first use
+    // after a change, the index buffer follows on the next drawClusters().
+    mutable vector<Triangle> clusterTriangles;
+    mutable vector<MeshCluster> clusters;
+    mutable unsigned int clustersRevision = ~0u;
+    GLuint clusterIndexBuffer = 0;
+    unsigned int clusterBufferRevision = ~0u;
+
+    void buildClusters() const;
+    // enable and set the vertex, normal and color arrays of the uploaded buffers
+    void bindArrays(QOpenGLFunctions_2_1 *f);
+    void unbindArrays(QOpenGLFunctions_2_1 *f);
+
+    // triangulate consecutive scanner sweeps (runs of equal alpha, ordered by beta)
+    void triangulateSweeps(const vector<float> &alphas, const vector<float> &betas,
+                           float maxEdgeFactor);
 
 public:
+    TriangleMesh() = default;
+    // the GL buffer names are owned by this mesh, a copy would delete them a second time
+    TriangleMesh(const TriangleMesh &) = delete;
+    TriangleMesh &operator=(const TriangleMesh &) = delete;
+
     // ================
     // === RAW DATA ===
     // ================
@@ -52,27 +177,102 @@ public:
     const vector<Triangle> &getTriangles() const;
     const vector<Normal> &getNormals() const;
 
+    // bounds, area, volume, edge lengths and degenerate faces, computed in one parallel pass
+    // over vertices and triangles and cached until the mesh changes
+    const MeshStatistics &getStatistics() const;
+
+    // per vertex colors used by draw() instead of white. they are ignored while their count
+    // differs from the vertex count and do not change the revision.
+    void setColors(vector<Vec3f> newColors);
+    const vector<Vec3f> &getColors() const { return colors; }
+
+    // triangle clusters for culling: up to CLUSTER_TRIANGLES neighboring triangles each with
+    // their bounds, built with a parallel sort of the triangle centroids along a Morton curve
+    static const uint32_t CLUSTER_TRIANGLES = 1024;
+    const vector<MeshCluster> &getClusters() const;
+    // all triangles reordered so that every cluster is a contiguous range
+    const vector<Triangle> &getClusterTriangles() const;
+
+    // changes whenever vertices or triangles might have changed
+    unsigned int getRevision() const { return revision; }
+    // changes whenever the normals might have changed, without affecting getRevision() if
+    // only they did (e.g. calculateNormals())
+    unsigned int getNormalsRevision() const { return normalsRevision; }
+
     // flip all normals
     void flipNormals();
+
+    // bake a transformation into vertices and normals (parallel over all cores)
+    void transform(const Mat4f &m);
+
+    // append a transformed copy of another mesh (instance flattening)
+    void appendInstance(const TriangleMesh &instance, const Mat4f &m);
+
+    // Laplacian smoothing with uniform or cotangent weights: every iteration moves each vertex
+    // by lambda towards the weighted average of its neighbors. if mu is not 0 each step is
+    // followed by a second one with factor mu (Taubin, e.g. lambda 0.5 and mu -0.53), which
+    // counteracts the shrinking. boundary vertices stay fixed. recalculates normals.
+    void smooth(unsigned int iterations, bool cotangentWeights = false, float lambda = 0.5f,
+                float mu = 0.f);
+
+    // Loop subdivision, every level splits each triangle into four. with adaptive criteria only
+    // the selected triangles are split into four, their neighbors into two or three to avoid
+    // cracks, and only vertices whose edges were all split are smoothed. recalculates normals
+    // and returns the triangle counts and time of every level done.
+    vector<SubdivisionLevel> subdivideLoop(unsigned int levels = 1,
+                                           const AdaptiveSubdivision *adaptive = nullptr);
+
     void calculateNormals(bool weightByAngle = false);
-    void drawNormals();
+    // add a line along the normal of every vertex, moved by offset, to lines. they are drawn
+    // with the other lines of the buffer. a length <= 0 selects 2% of the bounding box diagonal.
+    void drawNormals(DebugLines &lines, float length = 0.f, const Vec3f &offset = Vec3f()) const;
 
     // =================
     // === LOAD MESH ===
     // =================
 
-    // read from an LSA file. also calculates normals.
-    void loadLSA(const char *filename);
+    // copy vertices, normals and triangles for diffReload()
+    MeshSnapshot snapshot() const;
+    // compare a freshly loaded mesh against a snapshot of the mesh it replaces. only reads, so
+    // it can run on the loading thread while the snapshotted mesh is still drawn and edited.
+    MeshReloadDiff diffReload(const MeshSnapshot &previous) const;
+    // take over the data of a freshly loaded mesh. if the triangles are unchanged and the mesh
+    // was not modified since the snapshot of the diff, only the changed vertex ranges are
+    // re-uploaded. returns true in that case, false if everything is uploaded again.
+    bool reloadFrom(TriangleMesh &other, const MeshReloadDiff &diff);
+
+    // read from an LSA file. also calculates normals. if triangulate is set, files without faces
+    // and with at most MAX_SWEEP_TRIANGULATION_POINTS points are triangulated from their sweep
+    // structure. triangles whose longest edge, relative to their distance from the scanner,
+    // exceeds maxEdgeFactor times the median span a depth discontinuity and are dropped.
+    static const size_t MAX_SWEEP_TRIANGULATION_POINTS = 20000000;
+    void loadLSA(const char *filename, bool triangulate = false, float maxEdgeFactor = 5.f);
 
     // read from an OBJ file. also calculates normals.
     void loadOBJ(const char *filename);
 
+    // read from a compressed CMSH file (see meshcodec.h). chunks are decoded in parallel.
+    // also calculates normals.
+    void loadCMSH(const char *filename);
+
+    // write to a compressed CMSH file. vertices are renumbered in order of first use and
+    // positions are quantized to quantizationBits per axis.
+    bool saveCMSH(const char *filename, unsigned int quantizationBits = 16) const;
+
     // ==============
     // === RENDER ===
     // ==============
 
+    // upload changed data to the GPU buffers. returns the number of bytes uploaded.
+    size_t uploadBuffers(QOpenGLFunctions_2_1 *f);
+
+    // delete the GPU buffers, needs a current context
+    void releaseBuffers(QOpenGLFunctions_2_1 *f);
+
     // draw mesh with set transformation
     void draw(QOpenGLFunctions_2_1 *f);
+    // draw only the clusters with visible[i] != 0, adjacent visible clusters in one call
+    void drawClusters(QOpenGLFunctions_2_1 *f, const vector<unsigned char> &visible);
 };
 
 #endif
@@ -79,6 +79,12 @@ public:
 
     T operator*(const Vec3 &v) const { return x() * v.x() + y() * v.y() + z() * v.z(); }
 
+    bool operator==(const Vec3 &v) const
+    {
+        return data[0] == v[0] && data[1] == v[1] && data[2] == v[2];
+    }
+    bool operator!=(const Vec3 &v) const { return !(*this == v); }
+
     friend Vec3 operator*(Vec3 v, const T f)
     {
         v *= f;
@@ -122,24 +128,27 @@ public:
     // rotates the vector around x (angle in degree)
     void rotX(float angle)
     {
-        float y_new = cos(angle * M_RadToDeg) * y() - sin(angle * M_RadToDeg) * z();
-        float z_new = sin(angle * M_RadToDeg) * y() + cos(angle * M_RadToDeg) * z();
+        const float c = cos(angle * M_RadToDeg), s = sin(angle * M_RadToDeg);
+        float y_new = c * y() - s * z();
+        float z_new = s * y() + c * z();
         y() = y_new;
         z() = z_new;
     }
     // rotates the vector around y (angle in degree)
     void rotY(float angle)
     {
-        float x_new = cos(angle * M_RadToDeg) * x() + sin(angle * M_RadToDeg) * z();
-        float z_new = -sin(angle * M_RadToDeg) * x() + cos(angle * M_RadToDeg) * z();
+        const float c = cos(angle * M_RadToDeg), s = sin(angle * M_RadToDeg);
+        float x_new = c * x() + s * z();
+        float z_new = -s * x() + c * z();
         x() = x_new;
         z() = z_new;
     }
     // rotates the vector around z (angle in degree)
     void rotZ(float angle)
     {
-        float x_new = cos(angle * M_RadToDeg) * x() - sin(angle * M_RadToDeg) * y();
-        float y_new = sin(angle * M_RadToDeg) * x() + cos(angle * M_RadToDeg) * y();
+        const float c = cos(angle * M_RadToDeg), s = sin(angle * M_RadToDeg);
+        float x_new = c * x() - s * y();
+        float y_new = s * x() + c * y();
         x() = x_new;
         y() = y_new;
     }